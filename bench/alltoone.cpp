@@ -2,13 +2,14 @@
 #include <sys/mman.h>
 #include <iostream>
 #include "../lib/rewiring.tcc"
+#include "util/harness.h"
 #include<chrono>
 #include "emmintrin.h"
 std::pair<size_t,size_t> bench(bool use_lkm,size_t num_pages){
     //1. create rewiring instance
     rewiring* r=rewiring::create(use_lkm);
     //2. measure time for'all-to-one' setup
-    auto start=std::chrono::system_clock::now();
+    auto start=std::chrono::steady_clock::now();
     r->resize(num_pages);
     auto* m= static_cast<uint8_t *>(r->getMapping());
     PageId firstPageId;
@@ -21,16 +22,16 @@ std::pair<size_t,size_t> bench(bool use_lkm,size_t num_pages){
     m[0]=1;
     _mm_mfence();
     r->syncToPT(0,num_pages);
-    auto end=std::chrono::system_clock::now();
+    auto end=std::chrono::steady_clock::now();
     //store 'all-to-one' setup time
     size_t setup=std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
     //3. measure time for 'all-to-one' iteration
-    start=std::chrono::system_clock::now();
+    start=std::chrono::steady_clock::now();
     //access the first byte of every page (and check result)
     for(size_t i=0;i<num_pages;i++){
         if(m[i*4096]!=1)std::cout<<"wrong:"<<i<<std::endl;
     }
-    end=std::chrono::system_clock::now();
+    end=std::chrono::steady_clock::now();
     //store time for iteration
     size_t iter=std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
     //cleanup
@@ -55,14 +56,16 @@ void perform_bench(size_t num_pages,std::ofstream& out){
         lkm_iter = std::min(lkm_iter,p.second);
 
     }
+    print_stats("lkm "+std::to_string(num_pages)+" pages (10 runs), min setup",lkm_setup);
     //perform 10x benchmark for mmap
     for(int i=0;i<10;i++) {
         auto p=bench(false, num_pages);
         mmap_setup = std::min(mmap_setup,p.first);
         mmap_iter = std::min(mmap_iter,p.second);
     }
+    print_stats("mmap "+std::to_string(num_pages)+" pages (10 runs), min setup",mmap_setup);
     //write to CSV
-    out<<num_pages<<";"<<lkm_setup<<";"<<lkm_iter<<";"<<mmap_iter<<";"<<mmap_setup<<std::endl;
+    out<<num_pages<<";"<<lkm_setup<<";"<<lkm_iter<<";"<<mmap_setup<<";"<<mmap_iter<<std::endl;
 }
 int main(){
     std::ofstream out("result.csv");
@@ -0,0 +1,69 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+#include "../lib/rewiring.tcc"
+#include "../lib/checkpoint.tcc"
+struct result{
+    size_t checkpoint;
+    size_t restore;
+};
+result bench(bool use_lkm,size_t num_pages,const std::string& path){
+    //1. create a rewired structure: a main mapping and a view with both halves swapped
+    rewiring* r=rewiring::create(use_lkm);
+    r->resize(num_pages);
+    auto* m=static_cast<uint64_t*>(r->getMapping());
+    for(size_t i=0;i<num_pages;i++){
+        m[i*512]=i;
+    }
+    r->syncFromPT(0,num_pages);
+    std::vector<PageId> swapped(r->getPageIds(),r->getPageIds()+num_pages);
+    std::rotate(swapped.begin(),swapped.begin()+num_pages/2,swapped.end());
+    rewiring_view* view=r->createView(swapped.data(),num_pages);
+    //2. measure time for writing the checkpoint
+    auto start=std::chrono::steady_clock::now();
+    checkpoint_rewiring(r,{view},path);
+    auto end=std::chrono::steady_clock::now();
+    size_t checkpoint=std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    delete view;
+    delete r;
+    //3. measure time for restoring the checkpoint into a new rewiring object
+    r=rewiring::create(use_lkm);
+    start=std::chrono::steady_clock::now();
+    std::vector<rewiring_view*> views=restore_rewiring(r,path);
+    end=std::chrono::steady_clock::now();
+    size_t restore=std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    //check restored content of the main mapping and the view
+    m=static_cast<uint64_t*>(r->getMapping());
+    auto* v=static_cast<uint64_t*>(views[0]->getMapping());
+    for(size_t i=0;i<num_pages;i++){
+        if(m[i*512]!=i||v[i*512]!=(i+num_pages/2)%num_pages)std::cout<<"wrong:"<<i<<std::endl;
+    }
+    delete views[0];
+    delete r;
+    return {checkpoint,restore};
+}
+void perform_bench(size_t num_pages,std::ofstream& out){
+    //execute every benchmark 5 times and take the minimum
+    for(bool use_lkm:{true,false}){
+        result best{std::numeric_limits<size_t>::max(),std::numeric_limits<size_t>::max()};
+        for(int i=0;i<5;i++){
+            result res=bench(use_lkm,num_pages,"checkpoint.bin");
+            best.checkpoint=std::min(best.checkpoint,res.checkpoint);
+            best.restore=std::min(best.restore,res.restore);
+        }
+        std::remove("checkpoint.bin");
+        //write to CSV
+        out<<num_pages<<";"<<(use_lkm?"lkm":"mmap")<<";"<<best.checkpoint<<";"<<best.restore<<std::endl;
+    }
+}
+int main(){
+    std::ofstream out("result.csv");
+    out<<"#pages;type;checkpoint;restore"<<std::endl;
+    //perform benchmarks for pools of 64MB, 256MB, 1GB and 4GB
+    for(size_t num_pages:{16384,65536,262144,1048576}){
+        perform_bench(num_pages,out);
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <chrono>
+#include "../lib/rewiring.tcc"
+//number of distinct "dictionary" pages that duplicated pages are copied from
+constexpr size_t dictionary_pages=16;
+struct result{
+    size_t freed;
+    size_t dedup;
+    size_t scan_before;
+    size_t scan_after;
+    size_t write_after;
+};
+size_t scan(const uint64_t* m,size_t num_pages,uint64_t& sum){
+    auto start=std::chrono::steady_clock::now();
+    for(size_t i=0;i<num_pages*512;i++){
+        sum+=m[i];
+    }
+    auto end=std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+}
+result bench(size_t num_pages,double duplication){
+    //1. create synthetic table: a fraction of the pages are copies of a few dictionary pages
+    lkm_rewiring r;
+    r.resize(num_pages);
+    auto* m=static_cast<uint64_t*>(r.getMapping());
+    std::mt19937_64 gen(42);
+    std::bernoulli_distribution duplicated(duplication);
+    std::uniform_int_distribution<size_t> dictionary(0,dictionary_pages-1);
+    for(size_t i=0;i<num_pages;i++){
+        bool dup=duplicated(gen);
+        size_t content=dup?dictionary(gen):dictionary_pages+i;
+        for(size_t j=0;j<512;j++){
+            m[i*512+j]=content*512+j;
+        }
+    }
+    //2. scan before deduplication
+    uint64_t sumBefore=0;
+    size_t scanBefore=scan(m,num_pages,sumBefore);
+    //3. measure deduplication
+    auto start=std::chrono::steady_clock::now();
+    size_t freed=r.deduplicate();
+    auto end=std::chrono::steady_clock::now();
+    size_t dedup=std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    //4. scan after deduplication (shared pages are faulted in read-only again)
+    uint64_t sumAfter=0;
+    size_t scanAfter=scan(m,num_pages,sumAfter);
+    if(sumBefore!=sumAfter)std::cout<<"wrong sum:"<<sumBefore<<"!="<<sumAfter<<std::endl;
+    //5. write to every page: shared pages are split again
+    start=std::chrono::steady_clock::now();
+    for(size_t i=0;i<num_pages;i++){
+        m[i*512]++;
+    }
+    end=std::chrono::steady_clock::now();
+    size_t writeAfter=std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    return {freed,dedup,scanBefore,scanAfter,writeAfter};
+}
+int main(){
+    //deduplication is only implemented by the kernel module
+    std::ifstream f("/dev/rewiring");
+    if(!f.good()){
+        std::cerr<<"kernel module not loaded"<<std::endl;
+        return 1;
+    }
+    std::ofstream out("result.csv");
+    out<<"#pages;duplication;freed_pages;saved_bytes;dedup;scan_before;scan_after;write_after"<<std::endl;
+    //table of 1GB, 0%, 10%, 50%, 90% and 100% duplicated pages
+    size_t num_pages=262144;
+    for(double duplication:{0.0,0.1,0.5,0.9,1.0}){
+        result res=bench(num_pages,duplication);
+        //write to CSV
+        out<<num_pages<<";"<<duplication<<";"<<res.freed<<";"<<res.freed*4096<<";"<<res.dedup<<";"<<res.scan_before<<";"<<res.scan_after<<";"<<res.write_after<<std::endl;
+    }
+    return 0;
+}
@@ -1,5 +1,6 @@
 
 #include "util/deque.h"
+#include "util/harness.h"
 #include <iostream>
 #include <deque>
 #include <cassert>
@@ -12,7 +13,7 @@ enum deque_impl{
 size_t bench(deque_impl impl,size_t num_entries,size_t shifts) {
     if(impl==STD){
         std::deque<size_t> q;
-        auto start = std::chrono::system_clock::now();
+        auto start = std::chrono::steady_clock::now();
         //first insert num_entries elements into deque
         for (size_t i = 0; i < num_entries; i++) {
             q.push_back(i);
@@ -22,12 +23,12 @@ size_t bench(deque_impl impl,size_t num_entries,size_t shifts) {
             q.push_back(i);
             q.pop_front();
         }
-        auto end = std::chrono::system_clock::now();
+        auto end = std::chrono::steady_clock::now();
         //return measured time in nanoseconds
         return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
     }else {
         rewired_deque<Page, size_t> q(impl==REWIRED_LKM);
-        auto start = std::chrono::system_clock::now();
+        auto start = std::chrono::steady_clock::now();
         //first insert num_entries elements into deque
         for (size_t i = 0; i < num_entries; i++) {
             q.push_back(i);
@@ -37,12 +38,33 @@ size_t bench(deque_impl impl,size_t num_entries,size_t shifts) {
             q.push_back(i);
             q.pop_front();
         }
-        auto end = std::chrono::system_clock::now();
+        auto end = std::chrono::steady_clock::now();
         //return measured time in nanoseconds
         return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
     }
 }
-
+//measures a full-range syncToPT of a filled rewired deque after only num_changed page ids were changed
+//the kernel module only rewrites the page table entries of changed pages
+size_t bench_partial_update(bool use_lkm,size_t num_entries,size_t num_changed){
+    rewired_deque<Page, size_t> q(use_lkm);
+    for (size_t i = 0; i < num_entries; i++) {
+        q.push_back(i);
+    }
+    q.prefault();
+    rewiring* r=q.sr.r;
+    size_t numPages=r->getNumPages();
+    r->syncFromPT(0,numPages);
+    //swap the page ids of num_changed/2 page pairs, spread over the whole mapping
+    size_t step=numPages/num_changed;
+    for(size_t i=0;i+1<num_changed;i+=2){
+        std::swap(r->getPageIds()[i*step],r->getPageIds()[(i+1)*step]);
+    }
+    auto start = std::chrono::steady_clock::now();
+    r->syncToPT(0,numPages);
+    auto end = std::chrono::steady_clock::now();
+    //return measured time in nanoseconds
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
 
 int main(){
     //benchmark config: #entries=100000000, #shifts=1000000000
@@ -50,13 +72,22 @@ int main(){
     size_t shifts=1000000000;
     //execute benchmark for the three deque implementations
     size_t lkm=bench(REWIRED_LKM, numEntries,shifts);
+    print_stats("lkm",lkm);
     size_t mmap=bench(REWIRED_MMAP, numEntries,shifts);
+    print_stats("mmap",mmap);
     size_t std=bench(STD, numEntries,shifts);
+    print_stats("std",std);
     //write result as csv
     std::ofstream out("result.csv");
     out<<"type;time"<<std::endl;
     out << "lkm" << ";"  << lkm << std::endl;
     out << "mmap" << ";"  << mmap << std::endl;
     out << "std" << ";"  << std << std::endl;
+    //partial updates: cost should depend on the number of changed pages, not on the size of the range
+    std::ofstream partial("result_partial.csv");
+    partial<<"changed_pages;lkm;mmap"<<std::endl;
+    for(size_t changed:{2,16,256,4096}){
+        partial<<changed<<";"<<bench_partial_update(true,numEntries,changed)<<";"<<bench_partial_update(false,numEntries,changed)<<std::endl;
+    }
     return 0;
 }
\ No newline at end of file
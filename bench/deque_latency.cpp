@@ -0,0 +1,111 @@
+#include <iostream>
+#include <deque>
+#include <memory>
+#include "util/harness.h"
+#include "util/deque.h"
+#include "../lib/rewiring_deque.tcc"
+//latency distribution of single push operations: rewiring_deque vs. std::deque vs. the rewired deque of bench/util/deque.h
+//*_nontrivial use a non-trivially copyable element type, whose elements are moved one by one at ring jumps
+//workloads: "push" fills an empty deque, "queue" pushes to the back and pops from the front of a filled deque
+//size is the number of pages of elements (512 elements per page), latencies include the overhead of reading the clock
+
+//non-trivially copyable element: rewiring_deque move-constructs all elements when it jumps by one ring
+struct nontrivial{
+    size_t value;
+    nontrivial(size_t value):value(value){}
+    nontrivial(const nontrivial& other):value(other.value){}
+    nontrivial(nontrivial&& other) noexcept:value(other.value){}
+    nontrivial& operator=(const nontrivial& other){
+        value=other.value;
+        return *this;
+    }
+};
+//measures every single push_back, optionally followed by a pop_front
+template<typename Deque>
+std::vector<size_t> measure(Deque& q,size_t elements,bool pop){
+    std::vector<size_t> samples(elements);
+    for(size_t i=0;i<elements;i++){
+        auto start=std::chrono::steady_clock::now();
+        q.push_back(i);
+        auto end=std::chrono::steady_clock::now();
+        samples[i]=std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+        if(pop){
+            q.pop_front();
+        }
+    }
+    return samples;
+}
+template<typename Deque>
+std::vector<size_t> bench(Deque& q,const std::string& workload,size_t elements){
+    if(workload=="queue"){
+        for(size_t i=0;i<elements;i++){
+            q.push_back(i);
+        }
+        return measure(q,elements,true);
+    }
+    return measure(q,elements,false);
+}
+std::vector<size_t> bench_impl(const std::string& impl,const std::string& workload,size_t elements){
+    if(impl=="std"){
+        std::deque<size_t> q;
+        return bench(q,workload,elements);
+    }else if(impl=="std_nontrivial"){
+        std::deque<nontrivial> q;
+        return bench(q,workload,elements);
+    }else if(impl=="rewiring_deque_nontrivial_lkm"||impl=="rewiring_deque_nontrivial_mmap"){
+        rewiring_deque<nontrivial> q(impl=="rewiring_deque_nontrivial_lkm");
+        return bench(q,workload,elements);
+    }else if(impl=="rewiring_deque_lkm"||impl=="rewiring_deque_mmap"){
+        rewiring_deque<size_t> q(impl=="rewiring_deque_lkm");
+        return bench(q,workload,elements);
+    }else{
+        rewired_deque<Page,size_t> q(impl=="rewired_deque_lkm");
+        return bench(q,workload,elements);
+    }
+}
+int main(int argc,char** argv){
+    bench_options o=bench_options::parse(argc,argv);
+    bool lkm_present=std::ifstream("/dev/rewiring").good();
+    std::vector<std::string> impls{"std","std_nontrivial"};
+    for(const std::string& backend:o.backends){
+        if(backend=="lkm"&&!lkm_present){
+            std::cerr<<"kernel module not loaded, skipping lkm backend"<<std::endl;
+            continue;
+        }
+        impls.push_back("rewiring_deque_"+backend);
+        impls.push_back("rewired_deque_"+backend);
+        impls.push_back("rewiring_deque_nontrivial_"+backend);
+    }
+    std::ofstream out(o.out);
+    out<<"workload;impl;elements;runs;p50;p99;p999;max;total"<<std::endl;
+    for(const std::string workload:{"push","queue"}){
+        if(!o.selected(workload))continue;
+        for(size_t pages:o.sizes){
+            size_t elements=pages*(rewiring::page_size/sizeof(size_t));
+            for(const std::string& impl:impls){
+                try{
+                    for(size_t i=0;i<o.warmup;i++){
+                        bench_impl(impl,workload,elements);
+                    }
+                    //the samples of all runs form one distribution
+                    std::vector<size_t> samples;
+                    size_t total=0;
+                    for(size_t i=0;i<o.runs;i++){
+                        std::vector<size_t> run=bench_impl(impl,workload,elements);
+                        for(size_t s:run)total+=s;
+                        samples.insert(samples.end(),run.begin(),run.end());
+                    }
+                    //size 0: no push was measured
+                    if(samples.empty())continue;
+                    std::sort(samples.begin(),samples.end());
+                    out<<workload<<";"<<impl<<";"<<elements<<";"<<o.runs<<";"<<percentile(samples,0.5)<<";"<<percentile(samples,0.99)<<";"
+                       <<percentile(samples,0.999)<<";"<<samples.back()<<";"<<total/o.runs<<std::endl;
+                }catch(const std::system_error& e){
+                    //mmap-based rewiring may run out of mappings (vm.max_map_count)
+                    std::cerr<<workload<<"/"<<impl<<"/"<<elements<<" failed: "<<e.what()<<std::endl;
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include "../lib/rewiring.tcc"
+//loads a file into a rewired mapping:
+// * write_pages_file: WRITE_PAGES reads the file into new pages, then one syncToPT maps them
+// * read_mapping: read() directly into the (not yet faulted) mapping
+// * write_pages_buffer: WRITE_PAGES copies a user buffer into new pages, then one syncToPT maps them
+// * fault_memcpy: memcpy of a user buffer into the mapping (a fault per page)
+//the file is in the page cache, the buffer is already populated
+enum ingest_impl{
+    WRITE_PAGES_FILE,READ_MAPPING,WRITE_PAGES_BUFFER,FAULT_MEMCPY
+};
+size_t bench(ingest_impl impl,int fileFd,const char* buffer,size_t num_pages){
+    lkm_rewiring r;
+    r.resize(num_pages);
+    auto* m=static_cast<char*>(r.getMapping());
+    size_t bytes=num_pages*rewiring::page_size;
+    auto start=std::chrono::steady_clock::now();
+    switch(impl){
+        case WRITE_PAGES_FILE:
+            r.createPageIdsFromFile(num_pages,fileFd,0,r.getPageIds());
+            r.syncToPT(0,num_pages);
+            break;
+        case WRITE_PAGES_BUFFER:
+            r.createPageIdsFromBuffer(num_pages,buffer,r.getPageIds());
+            r.syncToPT(0,num_pages);
+            break;
+        case READ_MAPPING:
+            for(size_t done=0;done<bytes;){
+                ssize_t res=pread(fileFd,m+done,bytes-done,done);
+                if(res<=0){
+                    throw std::system_error(errno,std::generic_category(),"read failed");
+                }
+                done+=res;
+            }
+            break;
+        case FAULT_MEMCPY:
+            std::memcpy(m,buffer,bytes);
+            break;
+    }
+    auto end=std::chrono::steady_clock::now();
+    //check the complete content of every page
+    for(size_t i=0;i<num_pages;i++){
+        if(std::memcmp(m+i*rewiring::page_size,buffer+i*rewiring::page_size,rewiring::page_size)!=0){
+            std::cout<<"wrong content in page "<<i<<std::endl;
+            break;
+        }
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+}
+int main(){
+    //WRITE_PAGES is only implemented by the kernel module
+    std::ifstream f("/dev/rewiring");
+    if(!f.good()){
+        std::cerr<<"kernel module not loaded"<<std::endl;
+        return 1;
+    }
+    std::ofstream out("result.csv");
+    out<<"#pages;write_pages_file;read_mapping;write_pages_buffer;fault_memcpy"<<std::endl;
+    //files of 4MB-1GB
+    for(size_t num_pages=1024;num_pages<=262144;num_pages*=4){
+        size_t bytes=num_pages*rewiring::page_size;
+        //every word holds its offset, so every page has a different content
+        std::vector<char> buffer(bytes);
+        for(size_t i=0;i<bytes;i+=sizeof(size_t)){
+            *reinterpret_cast<size_t*>(&buffer[i])=i;
+        }
+        //write the data to a file, it stays in the page cache
+        FILE* file=tmpfile();
+        if(file==nullptr||fwrite(buffer.data(),1,bytes,file)!=bytes||fflush(file)!=0){
+            std::cerr<<"could not write temporary file"<<std::endl;
+            return 1;
+        }
+        int fileFd=fileno(file);
+        //execute every benchmark 3 times and take the minimum
+        size_t res[4];
+        for(int impl=0;impl<4;impl++){
+            res[impl]=std::numeric_limits<size_t>::max();
+            for(int i=0;i<3;i++){
+                res[impl]=std::min(res[impl],bench(static_cast<ingest_impl>(impl),fileFd,buffer.data(),num_pages));
+            }
+        }
+        fclose(file);
+        //write to CSV
+        out<<num_pages<<";"<<res[WRITE_PAGES_FILE]<<";"<<res[READ_MAPPING]<<";"<<res[WRITE_PAGES_BUFFER]<<";"<<res[FAULT_MEMCPY]<<std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include <iostream>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+#include "../lib/versioned_array.tcc"
+//multi-version column of 64MB (uint64_t), a chain of versions with random writes each:
+// * commit: creating one version (mean over all versions)
+// * scan_oldest/scan_latest: sum over all elements of the oldest/latest version
+// * gc: releasing all versions except the latest one
+//compares versioned_array (lkm and mmap backend) with a copy-on-write array of page sized chunks
+//(a version is a vector of chunk pointers, changed chunks are copied, readers go through the chunk vector)
+enum mvcc_impl{
+    REWIRED_LKM,REWIRED_MMAP,COW_CHUNKS
+};
+struct mvcc_result{
+    size_t commit;
+    size_t scan_oldest;
+    size_t scan_latest;
+    size_t gc;
+};
+constexpr size_t num_pages=16384;
+constexpr size_t elements_per_page=rewiring::page_size/sizeof(uint64_t);
+constexpr size_t num_elements=num_pages*elements_per_page;
+constexpr size_t num_versions=16;
+
+//copy-on-write baseline
+class cow_array{
+    using chunk=std::array<uint64_t,elements_per_page>;
+    std::vector<std::vector<std::shared_ptr<chunk>>> versions;
+public:
+    cow_array(){
+        std::vector<std::shared_ptr<chunk>> first(num_pages);
+        for(auto& c:first){
+            c=std::make_shared<chunk>();
+            c->fill(0);
+        }
+        versions.push_back(std::move(first));
+    }
+    size_t commit(const std::vector<std::pair<size_t,uint64_t>>& writes){
+        std::vector<std::shared_ptr<chunk>> next=versions.back();
+        const auto& latest=versions.back();
+        for(auto& w:writes){
+            size_t page=w.first/elements_per_page;
+            if(next[page]==latest[page]){
+                next[page]=std::make_shared<chunk>(*latest[page]);
+            }
+            (*next[page])[w.first%elements_per_page]=w.second;
+        }
+        versions.push_back(std::move(next));
+        return versions.size()-1;
+    }
+    uint64_t scan(size_t version) const {
+        uint64_t sum=0;
+        for(auto& c:versions[version]){
+            for(uint64_t v:*c){
+                sum+=v;
+            }
+        }
+        return sum;
+    }
+    void gc(){
+        versions.erase(versions.begin(),versions.end()-1);
+    }
+};
+uint64_t scan(const uint64_t* data){
+    uint64_t sum=0;
+    for(size_t i=0;i<num_elements;i++){
+        sum+=data[i];
+    }
+    return sum;
+}
+size_t elapsed(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+}
+mvcc_result bench(mvcc_impl impl,size_t writes_per_version){
+    std::mt19937_64 gen(42);
+    std::vector<std::vector<std::pair<size_t,uint64_t>>> writes(num_versions);
+    for(auto& w:writes){
+        for(size_t i=0;i<writes_per_version;i++){
+            w.push_back({gen()%num_elements,gen()%1024});
+        }
+    }
+    mvcc_result res{0,0,0,0};
+    uint64_t oldest,latest;
+    if(impl==COW_CHUNKS){
+        cow_array a;
+        auto start=std::chrono::steady_clock::now();
+        for(auto& w:writes){
+            a.commit(w);
+        }
+        res.commit=elapsed(start)/num_versions;
+        start=std::chrono::steady_clock::now();
+        oldest=a.scan(0);
+        res.scan_oldest=elapsed(start);
+        start=std::chrono::steady_clock::now();
+        latest=a.scan(num_versions);
+        res.scan_latest=elapsed(start);
+        start=std::chrono::steady_clock::now();
+        a.gc();
+        res.gc=elapsed(start);
+    }else{
+        versioned_array<uint64_t> a(num_elements,impl==REWIRED_LKM);
+        //version 0 consists of zero pages, populate them like the chunks of the baseline
+        scan(a.read(0));
+        auto start=std::chrono::steady_clock::now();
+        for(auto& w:writes){
+            a.commit(w);
+        }
+        res.commit=elapsed(start)/num_versions;
+        //first scan faults the pages of the new mapping in, measure the second one
+        scan(a.read(0));
+        scan(a.read(num_versions));
+        start=std::chrono::steady_clock::now();
+        oldest=scan(a.read(0));
+        res.scan_oldest=elapsed(start);
+        start=std::chrono::steady_clock::now();
+        latest=scan(a.read(num_versions));
+        res.scan_latest=elapsed(start);
+        start=std::chrono::steady_clock::now();
+        for(size_t v=0;v<num_versions;v++){
+            a.release(v);
+        }
+        res.gc=elapsed(start);
+    }
+    if(oldest!=0||latest==0){
+        std::cout<<"wrong sums "<<oldest<<" "<<latest<<std::endl;
+    }
+    return res;
+}
+int main(){
+    bool lkm_present=std::ifstream("/dev/rewiring").good();
+    if(!lkm_present){
+        std::cerr<<"kernel module not loaded, skipping lkm backend"<<std::endl;
+    }
+    std::ofstream out("result.csv");
+    out<<"#writes;impl;commit;scan_oldest;scan_latest;gc"<<std::endl;
+    const char* names[]={"rewired_lkm","rewired_mmap","cow_chunks"};
+    for(size_t writes_per_version:{16,1024,16384}){
+        for(int impl=0;impl<3;impl++){
+            if(impl==REWIRED_LKM&&!lkm_present)continue;
+            //execute every benchmark 3 times and take the minimum of every measurement
+            mvcc_result best{SIZE_MAX,SIZE_MAX,SIZE_MAX,SIZE_MAX};
+            try{
+                for(int i=0;i<3;i++){
+                    mvcc_result r=bench(static_cast<mvcc_impl>(impl),writes_per_version);
+                    best={std::min(best.commit,r.commit),std::min(best.scan_oldest,r.scan_oldest),
+                          std::min(best.scan_latest,r.scan_latest),std::min(best.gc,r.gc)};
+                }
+            }catch(const std::system_error& e){
+                //mmap-based views of scattered pages may run out of mappings (vm.max_map_count)
+                std::cerr<<names[impl]<<"/"<<writes_per_version<<" failed: "<<e.what()<<std::endl;
+                continue;
+            }
+            out<<writes_per_version<<";"<<names[impl]<<";"<<best.commit<<";"<<best.scan_oldest<<";"<<best.scan_latest<<";"
+               <<best.gc<<std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include "../lib/rewiring.tcc"
+//number of pages that may be resident (256MB)
+constexpr size_t resident_limit=65536;
+//number of random page accesses per measurement
+constexpr size_t accesses=1<<20;
+struct result{
+    size_t populate;
+    size_t uniform;
+    size_t skewed;
+};
+template<typename Dist>
+size_t access(uint64_t* m,Dist& dist,std::mt19937_64& gen,uint64_t& sum){
+    auto start=std::chrono::steady_clock::now();
+    for(size_t i=0;i<accesses;i++){
+        size_t page=dist(gen);
+        sum+=m[page*512]++;
+    }
+    auto end=std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+}
+result bench(size_t num_pages,int backingFd){
+    lkm_rewiring r;
+    r.enableReclaim(backingFd,resident_limit);
+    r.resize(num_pages);
+    auto* m=static_cast<uint64_t*>(r.getMapping());
+    //1. populate the working set: pages beyond the limit evict older pages
+    auto start=std::chrono::steady_clock::now();
+    for(size_t i=0;i<num_pages;i++){
+        m[i*512]=i;
+    }
+    auto end=std::chrono::steady_clock::now();
+    size_t populate=std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    std::mt19937_64 gen(42);
+    uint64_t sum=0;
+    //2. uniform random accesses: every access beyond the limit is likely to fault
+    std::uniform_int_distribution<size_t> uniform(0,num_pages-1);
+    size_t uniformTime=access(m,uniform,gen,sum);
+    //3. skewed accesses: hot pages should stay resident
+    std::geometric_distribution<size_t> geometric(8.0/num_pages);
+    auto skewed=[&](std::mt19937_64& g){return geometric(g)%num_pages;};
+    size_t skewedTime=access(m,skewed,gen,sum);
+    if(sum==0)std::cout<<"unexpected sum"<<std::endl;
+    return {populate,uniformTime,skewedTime};
+}
+int main(int argc,char** argv){
+    //reclaim is only implemented by the kernel module
+    std::ifstream f("/dev/rewiring");
+    if(!f.good()){
+        std::cerr<<"kernel module not loaded"<<std::endl;
+        return 1;
+    }
+    //backing file or device, e.g. a zram device: ./oversubscribe /dev/zram0
+    //every run creates new page ids starting at 0 and overwrites the evicted pages of the previous run
+    std::string path=argc>1?argv[1]:"rewiring_backing";
+    int backingFd=open(path.c_str(),argc>1?O_RDWR:O_RDWR|O_CREAT|O_TRUNC,0600);
+    if(backingFd<0){
+        std::cerr<<"could not open backing file "<<path<<std::endl;
+        return 1;
+    }
+    std::ofstream out("result.csv");
+    out<<"#pages;resident_limit;oversubscription;populate;uniform;skewed"<<std::endl;
+    for(double oversubscription:{0.5,1.0,1.5,2.0,4.0}){
+        size_t num_pages=resident_limit*oversubscription;
+        result res=bench(num_pages,backingFd);
+        //write to CSV, access times are per access
+        out<<num_pages<<";"<<resident_limit<<";"<<oversubscription<<";"<<res.populate<<";"<<res.uniform/accesses<<";"<<res.skewed/accesses<<std::endl;
+    }
+    close(backingFd);
+    if(argc<=1){
+        unlink(path.c_str());
+    }
+    return 0;
+}
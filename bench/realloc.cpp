@@ -0,0 +1,95 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstdlib>
+#include <sys/mman.h>
+#include "../lib/rewiring_heap.tcc"
+//the four buffer growth implementations for benchmarking:
+enum growth_impl{
+    REWIRED_LKM,REWIRED_MMAP,MALLOC,MREMAP
+};
+//touch the first byte of every page in [from,to) and check the content written before
+static bool touch(uint8_t* buf,size_t from,size_t to){
+    bool ok=true;
+    for(size_t i=0;i<from;i+=4096){
+        ok&=buf[i]==static_cast<uint8_t>(i/4096);
+        //checking every page is O(n^2) over all growth steps -> check only a few
+        i+=4096*1023;
+    }
+    for(size_t i=from;i<to;i+=4096){
+        buf[i]=static_cast<uint8_t>(i/4096);
+    }
+    return ok;
+}
+size_t bench(growth_impl impl,size_t max_bytes){
+    //grow a buffer from one page to max_bytes by repeated doubling, write to every new page
+    bool ok=true;
+    auto start=std::chrono::steady_clock::now();
+    switch(impl){
+        case MALLOC:{
+            auto* buf=static_cast<uint8_t*>(std::malloc(4096));
+            ok&=touch(buf,0,4096);
+            for(size_t size=4096;size<max_bytes;size*=2){
+                buf=static_cast<uint8_t*>(std::realloc(buf,size*2));
+                ok&=touch(buf,size,size*2);
+            }
+            std::free(buf);
+        } break;
+        case MREMAP:{
+            void* buf=mmap(NULL,4096,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+            ok&=touch(static_cast<uint8_t*>(buf),0,4096);
+            size_t size=4096;
+            for(;size<max_bytes;size*=2){
+                buf=mremap(buf,size,size*2,MREMAP_MAYMOVE);
+                if(buf==MAP_FAILED){
+                    throw std::system_error(errno,std::generic_category(),"mremap failed");
+                }
+                ok&=touch(static_cast<uint8_t*>(buf),size,size*2);
+            }
+            munmap(buf,size);
+        } break;
+        default:{
+            //the heap needs room for the old and the new buffer and is set up before measuring
+            rewiring_heap heap(4*max_bytes/4096,impl==REWIRED_LKM);
+            start=std::chrono::steady_clock::now();
+            //a second allocation directly behind the buffer prevents growing in place
+            auto* buf=static_cast<uint8_t*>(heap.allocate(4096));
+            void* blocker=heap.allocate(4096);
+            ok&=touch(buf,0,4096);
+            for(size_t size=4096;size<max_bytes;size*=2){
+                buf=static_cast<uint8_t*>(heap.reallocate(buf,size*2));
+                ok&=touch(buf,size,size*2);
+            }
+            heap.deallocate(blocker);
+            heap.deallocate(buf);
+            auto end=std::chrono::steady_clock::now();
+            if(!ok)std::cout<<"wrong content"<<std::endl;
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+        }
+    }
+    auto end=std::chrono::steady_clock::now();
+    if(!ok)std::cout<<"wrong content"<<std::endl;
+    //return measured time in nanoseconds
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+}
+void perform_bench(size_t max_bytes,std::ofstream& out){
+    //execute every benchmark 3 times and take the minimum
+    size_t res[4];
+    for(int impl=0;impl<4;impl++){
+        res[impl]=std::numeric_limits<size_t>::max();
+        for(int i=0;i<3;i++){
+            res[impl]=std::min(res[impl],bench(static_cast<growth_impl>(impl),max_bytes));
+        }
+    }
+    //write to CSV
+    out<<max_bytes<<";"<<res[REWIRED_LKM]<<";"<<res[REWIRED_MMAP]<<";"<<res[MALLOC]<<";"<<res[MREMAP]<<std::endl;
+}
+int main(){
+    std::ofstream out("result.csv");
+    out<<"bytes;lkm;mmap;malloc;mremap"<<std::endl;
+    //grow buffers to 1MB, 10MB, 100MB, 1GB and 10GB
+    for(size_t bytes=1ull<<20;bytes<=10ull<<30;bytes*=10){
+        perform_bench(bytes,out);
+    }
+    return 0;
+}
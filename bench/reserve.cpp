@@ -0,0 +1,92 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <climits>
+#include <limits>
+#include <functional>
+#include <memory>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <linux/memfd.h>
+#include "../lib/rewiring.tcc"
+#include "util/harness.h"
+struct result{
+    size_t time;
+    long memory;
+};
+result bench_mmap(int fd,size_t bytes){
+    //measure time and kernel memory for reserving (not touching) a mapping of the given size
+    size_t availableBefore=meminfo("MemAvailable");
+    auto start=std::chrono::steady_clock::now();
+    void* mapping=mmap(NULL,bytes,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_NORESERVE,fd,0);
+    auto end=std::chrono::steady_clock::now();
+    if(mapping==MAP_FAILED){
+        throw std::system_error(errno,std::generic_category(),"mmap failed");
+    }
+    long memory=static_cast<long>(availableBefore)-static_cast<long>(meminfo("MemAvailable"));
+    munmap(mapping,bytes);
+    return {static_cast<size_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count()),memory};
+}
+result bench_resize(bool use_lkm,size_t bytes){
+    //the same reservation through the library, which also keeps a page id array (4 bytes per page)
+    size_t availableBefore=meminfo("MemAvailable");
+    auto start=std::chrono::steady_clock::now();
+    std::unique_ptr<rewiring> r(rewiring::create(use_lkm));
+    r->resize(bytes/rewiring::page_size);
+    auto end=std::chrono::steady_clock::now();
+    long memory=static_cast<long>(availableBefore)-static_cast<long>(meminfo("MemAvailable"));
+    return {static_cast<size_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count()),memory};
+}
+void perform_bench(const char* type,const std::function<result()>& fn,size_t bytes,std::ofstream& out){
+    //execute every benchmark 10 times and take the minimum
+    result best{std::numeric_limits<size_t>::max(),std::numeric_limits<long>::max()};
+    try{
+        for(int i=0;i<10;i++){
+            result res=fn();
+            best.time=std::min(best.time,res.time);
+            best.memory=std::min(best.memory,res.memory);
+        }
+    }catch(std::system_error& e){
+        std::cerr<<type<<" "<<bytes<<": "<<e.what()<<std::endl;
+        return;
+    }catch(std::bad_alloc& e){
+        std::cerr<<type<<" "<<bytes<<": "<<e.what()<<std::endl;
+        return;
+    }
+    //write to CSV
+    out<<bytes<<";"<<type<<";"<<best.time<<";"<<best.memory<<std::endl;
+}
+int main(){
+    //reserve mappings directly through the kernel module and, for comparison, through a main memory file
+    int lkm=open("/dev/rewiring",O_RDWR);
+    if(lkm<0){
+        std::cerr<<"WARNING: kernel module not loaded, only measuring mmap-based reservations"<<std::endl;
+    }
+    int ramfile=memfd_create("ramfile",0);
+    if(ramfile<0||ftruncate(ramfile,LONG_MAX)!=0){
+        throw std::system_error(errno,std::generic_category(),"creation of ramfile failed");
+    }
+    std::ofstream out("result.csv");
+    out<<"bytes;type;time;memory_kb"<<std::endl;
+    //reserve 1GB, 16GB, 256GB, 4TB and 16TB
+    for(size_t bytes:{1ull<<30,16ull<<30,256ull<<30,4ull<<40,16ull<<40}){
+        if(lkm>=0){
+            perform_bench("lkm",[&]{return bench_mmap(lkm,bytes);},bytes,out);
+        }
+        perform_bench("mmap",[&]{return bench_mmap(ramfile,bytes);},bytes,out);
+        //the page id array of the library is dense (1GB for 1TB), only resize up to 256GB
+        if(bytes<=(256ull<<30)){
+            if(lkm>=0){
+                perform_bench("lkm_resize",[&]{return bench_resize(true,bytes);},bytes,out);
+            }
+            perform_bench("mmap_resize",[&]{return bench_resize(false,bytes);},bytes,out);
+        }
+    }
+    if(lkm>=0){
+        close(lkm);
+    }
+    close(ramfile);
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include "../lib/rewiring.tcc"
+#include "util/harness.h"
+//memory is measured by MemAvailable (meminfo):
+//pages of the kernel module are mapped with VM_PFNMAP and therefore not part of the RSS
+struct result{
+    size_t scan;
+    long memory;
+};
+result bench(bool use_lkm,size_t num_pages,size_t write_every){
+    //1. create sparse array: only every write_every-th page is written
+    rewiring* r=rewiring::create(use_lkm);
+    r->resize(num_pages);
+    auto* m=static_cast<uint8_t*>(r->getMapping());
+    size_t availableBefore=meminfo("MemAvailable");
+    for(size_t i=0;i<num_pages;i+=write_every){
+        m[i*4096]=1;
+    }
+    //2. measure time for reading the first byte of every page (first touch for most pages)
+    auto start=std::chrono::steady_clock::now();
+    size_t sum=0;
+    for(size_t i=0;i<num_pages;i++){
+        sum+=m[i*4096];
+    }
+    auto end=std::chrono::steady_clock::now();
+    size_t scan=std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    //3. memory consumed by writing and scanning
+    long memory=static_cast<long>(availableBefore)-static_cast<long>(meminfo("MemAvailable"));
+    if(sum!=(num_pages+write_every-1)/write_every)std::cout<<"wrong sum:"<<sum<<std::endl;
+    delete r;
+    return {scan,memory};
+}
+void perform_bench(size_t num_pages,size_t write_every,std::ofstream& out){
+    //execute every benchmark 10 times and take the minimum
+    for(bool use_lkm:{true,false}){
+        result best{std::numeric_limits<size_t>::max(),std::numeric_limits<long>::max()};
+        for(int i=0;i<10;i++){
+            result res=bench(use_lkm,num_pages,write_every);
+            best.scan=std::min(best.scan,res.scan);
+            best.memory=std::min(best.memory,res.memory);
+        }
+        //write to CSV
+        out<<num_pages<<";"<<write_every<<";"<<(use_lkm?"lkm":"mmap")<<";"<<best.scan<<";"<<best.memory<<std::endl;
+    }
+}
+int main(){
+    std::ofstream out("result.csv");
+    out<<"#pages;write_every;type;scan_time;memory_kb"<<std::endl;
+    //array of 1GB, every 1000th, 100th, 10th or every page is written before the scan
+    size_t num_pages=262144;
+    for(size_t write_every:{1000,100,10,1}){
+        perform_bench(num_pages,write_every,out);
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <memory>
+#include "util/harness.h"
+#include "util/deque.h"
+//microbenchmarks of the basic rewiring operations for every backend
+//size is the number of pages, every result row summarizes --runs measurements (in nanoseconds)
+
+//creates a rewiring object with exactly the requested backend
+static rewiring* create_backend(const std::string& backend,size_t pages){
+    rewiring* r=backend=="lkm"?static_cast<rewiring*>(new lkm_rewiring()):new mmap_rewiring();
+    r->resize(pages);
+    return r;
+}
+static void touch_pages(rewiring* r,size_t start,size_t pages){
+    auto* m=static_cast<uint8_t*>(r->getMapping());
+    for(size_t i=start;i<start+pages;i++){
+        m[i*4096]=static_cast<uint8_t>(i);
+    }
+}
+//rewire: syncToPT of a range whose two halves were swapped (all page ids changed)
+static void bench_rewire(measurement& m,rewiring* r,size_t pages){
+    PageId* ids=r->getPageIds();
+    std::rotate(ids,ids+pages/2,ids+pages);
+    m.start();
+    r->syncToPT(0,pages);
+    m.stop();
+}
+//fault: first write to every page of a fresh mapping
+static void bench_fault(measurement& m,const std::string& backend,size_t pages){
+    std::unique_ptr<rewiring> r(create_backend(backend,pages));
+    m.start();
+    touch_pages(r.get(),0,pages);
+    m.stop();
+}
+//resize: doubling of a populated mapping
+static void bench_resize(measurement& m,const std::string& backend,size_t pages){
+    std::unique_ptr<rewiring> r(create_backend(backend,pages));
+    touch_pages(r.get(),0,pages);
+    m.start();
+    r->resize(2*pages);
+    m.stop();
+}
+//reorganize: a full rewired deque moves its pages to the middle of the (grown) mapping
+static void bench_reorganize(measurement& m,const std::string& backend,size_t pages){
+    rewired_deque<Page,size_t> q(backend=="lkm");
+    while(q.sr.getNumPages()<pages||q.free_after()>0){
+        q.push_back(q.size());
+    }
+    m.start();
+    q.reorganize();
+    m.stop();
+}
+//alltoone: map one page to every page of the mapping
+static void bench_alltoone(measurement& m,const std::string& backend,size_t pages){
+    std::unique_ptr<rewiring> r(create_backend(backend,pages));
+    PageId first;
+    size_t position=0;
+    r->createNewPageIds(1,&position,&first);
+    std::fill(r->getPageIds(),r->getPageIds()+pages,first);
+    m.start();
+    r->syncToPT(0,pages);
+    m.stop();
+}
+//deque: push_back/pop_front shifts through a rewired deque holding as many pages of elements
+static void bench_deque(measurement& m,const std::string& backend,size_t pages){
+    rewired_deque<Page,size_t> q(backend=="lkm");
+    size_t elements=pages*(4096/sizeof(size_t));
+    for(size_t i=0;i<elements;i++){
+        q.push_back(i);
+    }
+    m.start();
+    for(size_t i=0;i<elements;i++){
+        q.push_back(i);
+        q.pop_front();
+    }
+    m.stop();
+}
+int main(int argc,char** argv){
+    bench_options o=bench_options::parse(argc,argv);
+    result_writer out(o);
+    bool lkm_present=std::ifstream("/dev/rewiring").good();
+    for(const std::string& backend:o.backends){
+        if(backend!="lkm"&&backend!="mmap"){
+            std::cerr<<"unknown backend "<<backend<<std::endl;
+            return 1;
+        }
+        if(backend=="lkm"&&!lkm_present){
+            std::cerr<<"kernel module not loaded, skipping lkm backend"<<std::endl;
+            continue;
+        }
+        for(size_t pages:o.sizes){
+            //runs a benchmark if selected, mmap-based rewiring may run out of mappings (vm.max_map_count)
+            auto run=[&](const std::string& bench,const std::function<void(measurement&)>& fn){
+                if(!o.selected(bench))return;
+                try{
+                    out.write(run_bench(o,bench,backend,pages,fn));
+                }catch(const std::system_error& e){
+                    std::cerr<<bench<<"/"<<backend<<"/"<<pages<<" failed: "<<e.what()<<std::endl;
+                }
+            };
+            run("rewire",[&](measurement& m){
+                //the page ids are created once per run, the measured syncToPT replaces all of them
+                std::unique_ptr<rewiring> r(create_backend(backend,pages));
+                touch_pages(r.get(),0,pages);
+                r->syncFromPT(0,pages);
+                bench_rewire(m,r.get(),pages);
+            });
+            run("fault",[&](measurement& m){bench_fault(m,backend,pages);});
+            run("resize",[&](measurement& m){bench_resize(m,backend,pages);});
+            run("reorganize",[&](measurement& m){bench_reorganize(m,backend,pages);});
+            run("alltoone",[&](measurement& m){bench_alltoone(m,backend,pages);});
+            run("deque",[&](measurement& m){bench_deque(m,backend,pages);});
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,326 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "../../lib/rewiring.tcc"
+
+//small benchmark harness: command line parameters, warmup, percentiles, perf counters, CSV/JSON output
+
+//command line options of a benchmark program, e.g.
+//  ./suite --bench=rewire,fault --backend=lkm --sizes=1024,65536 --runs=1000 --warmup=10 --format=json --out=result.json
+struct bench_options{
+    std::vector<std::string> benches;
+    std::vector<std::string> backends{"lkm","mmap"};
+    std::vector<size_t> sizes{1024,16384,262144};
+    size_t runs=100;
+    size_t warmup=5;
+    std::string format="csv";
+    std::string out="result.csv";
+
+    static std::vector<std::string> split(const std::string& s){
+        std::vector<std::string> res;
+        size_t pos=0;
+        while(pos<=s.size()){
+            size_t next=s.find(',',pos);
+            if(next==std::string::npos)next=s.size();
+            if(next>pos)res.push_back(s.substr(pos,next-pos));
+            pos=next+1;
+        }
+        return res;
+    }
+    [[noreturn]] static void usage(const char* program){
+        std::cerr<<"usage: "<<program<<" [--bench=a,b] [--backend=lkm,mmap] [--sizes=n,m] [--runs=n] [--warmup=n]"
+                 <<" [--format=csv|json] [--out=file]"<<std::endl;
+        std::exit(1);
+    }
+    static bench_options parse(int argc,char** argv){
+        bench_options o;
+        for(int i=1;i<argc;i++){
+            std::string arg=argv[i];
+            size_t eq=arg.find('=');
+            std::string key=arg.substr(0,eq);
+            std::string value=eq==std::string::npos?"":arg.substr(eq+1);
+            if(key=="--bench"){
+                o.benches=split(value);
+            }else if(key=="--backend"){
+                o.backends=split(value);
+            }else if(key=="--sizes"){
+                o.sizes.clear();
+                for(auto& s:split(value))o.sizes.push_back(std::stoull(s));
+            }else if(key=="--runs"){
+                o.runs=std::stoull(value);
+            }else if(key=="--warmup"){
+                o.warmup=std::stoull(value);
+            }else if(key=="--format"){
+                o.format=value;
+            }else if(key=="--out"){
+                o.out=value;
+            }else{
+                usage(argv[0]);
+            }
+        }
+        //results are summarized over the measured runs, at least one is needed
+        if(o.runs==0){
+            std::cerr<<"--runs has to be at least 1"<<std::endl;
+            usage(argv[0]);
+        }
+        return o;
+    }
+    bool selected(const std::string& bench) const {
+        return benches.empty()||std::find(benches.begin(),benches.end(),bench)!=benches.end();
+    }
+};
+
+//hardware/software counters of the calling thread, read around the measured region
+//counters that are not available (no permission, virtual machine, ...) are reported as -1
+class perf_counters{
+public:
+    enum counter{PAGE_FAULTS,DTLB_MISSES,SYSCALLS,NUM_COUNTERS};
+private:
+    int fds[NUM_COUNTERS];
+
+    static int open_counter(uint32_t type,uint64_t config){
+        perf_event_attr attr;
+        std::memset(&attr,0,sizeof(attr));
+        attr.size=sizeof(attr);
+        attr.type=type;
+        attr.config=config;
+        attr.disabled=1;
+        attr.exclude_hv=1;
+        int fd=static_cast<int>(syscall(__NR_perf_event_open,&attr,0,-1,-1,0));
+        if(fd<0){
+            //unprivileged users may only count user space events
+            attr.exclude_kernel=1;
+            fd=static_cast<int>(syscall(__NR_perf_event_open,&attr,0,-1,-1,0));
+        }
+        return fd;
+    }
+    static int open_syscall_counter(){
+        //syscalls are counted by the raw_syscalls:sys_enter tracepoint
+        for(const char* path:{"/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+                              "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"}){
+            std::ifstream f(path);
+            uint64_t id;
+            if(f>>id){
+                return open_counter(PERF_TYPE_TRACEPOINT,id);
+            }
+        }
+        return -1;
+    }
+public:
+    perf_counters(){
+        fds[PAGE_FAULTS]=open_counter(PERF_TYPE_SOFTWARE,PERF_COUNT_SW_PAGE_FAULTS);
+        fds[DTLB_MISSES]=open_counter(PERF_TYPE_HW_CACHE,PERF_COUNT_HW_CACHE_DTLB|(PERF_COUNT_HW_CACHE_OP_READ<<8)|(PERF_COUNT_HW_CACHE_RESULT_MISS<<16));
+        fds[SYSCALLS]=open_syscall_counter();
+    }
+    perf_counters(const perf_counters&)=delete;
+    perf_counters& operator=(const perf_counters&)=delete;
+
+    void start(){
+        for(int fd:fds){
+            if(fd>=0){
+                ioctl(fd,PERF_EVENT_IOC_RESET,0);
+                ioctl(fd,PERF_EVENT_IOC_ENABLE,0);
+            }
+        }
+    }
+    void stop(int64_t* values){
+        for(int i=0;i<NUM_COUNTERS;i++){
+            uint64_t value;
+            if(fds[i]>=0&&ioctl(fds[i],PERF_EVENT_IOC_DISABLE,0)==0&&read(fds[i],&value,sizeof(value))==sizeof(value)){
+                values[i]=static_cast<int64_t>(value);
+            }else{
+                values[i]=-1;
+            }
+        }
+    }
+    ~perf_counters(){
+        for(int fd:fds){
+            if(fd>=0)close(fd);
+        }
+    }
+};
+
+//passed to the benchmark function, which brackets the measured region with start()/stop()
+//setup and cleanup outside of start()/stop() is not measured
+class measurement{
+    perf_counters& counters;
+    std::chrono::steady_clock::time_point begin;
+    rewiring_stats statsBefore{};
+public:
+    size_t nanoseconds=0;
+    int64_t counts[perf_counters::NUM_COUNTERS]={-1,-1,-1};
+    //rewiring operations inside the measured region (all zero without REWIRING_STATS)
+    rewiring_stats stats{};
+
+    explicit measurement(perf_counters& counters):counters(counters){}
+    void start(){
+        statsBefore=rewiring_stats::current();
+        counters.start();
+        begin=std::chrono::steady_clock::now();
+    }
+    void stop(){
+        auto end=std::chrono::steady_clock::now();
+        counters.stop(counts);
+        nanoseconds=std::chrono::duration_cast<std::chrono::nanoseconds>(end-begin).count();
+        stats=rewiring_stats::current().since(statsBefore);
+    }
+};
+
+//summary of all measured runs of one benchmark configuration
+struct bench_result{
+    std::string bench;
+    std::string backend;
+    size_t size;
+    size_t runs;
+    double min,mean,p50,p99,p999,max;
+    //mean counter values per run (-1: not available)
+    double counts[perf_counters::NUM_COUNTERS];
+    //rewiring operations of all measured runs
+    rewiring_stats stats;
+};
+
+//percentile of sorted samples (nearest rank), samples must not be empty
+inline double percentile(const std::vector<size_t>& sorted,double p){
+    size_t rank=static_cast<size_t>(p*sorted.size()+0.999999);
+    return sorted[std::min(sorted.size(),std::max<size_t>(rank,1))-1];
+}
+
+//runs fn warmup times without recording, then runs times and summarizes the samples
+inline bench_result run_bench(const bench_options& o,const std::string& bench,const std::string& backend,size_t size,
+                              const std::function<void(measurement&)>& fn){
+    perf_counters counters;
+    for(size_t i=0;i<o.warmup;i++){
+        measurement m(counters);
+        fn(m);
+    }
+    std::vector<size_t> samples;
+    bench_result res{bench,backend,size,o.runs,0,0,0,0,0,0,{0,0,0},rewiring_stats{}};
+    for(size_t i=0;i<o.runs;i++){
+        measurement m(counters);
+        fn(m);
+        samples.push_back(m.nanoseconds);
+        for(int op=0;op<rewiring_stats::NUM_OPERATIONS;op++){
+            res.stats.operations[op].calls+=m.stats.operations[op].calls;
+            res.stats.operations[op].nanoseconds+=m.stats.operations[op].nanoseconds;
+            res.stats.operations[op].pages+=m.stats.operations[op].pages;
+        }
+        res.stats.mmapCalls+=m.stats.mmapCalls;
+        res.stats.ioctlCalls+=m.stats.ioctlCalls;
+        for(int c=0;c<perf_counters::NUM_COUNTERS;c++){
+            if(m.counts[c]<0||res.counts[c]<0){
+                res.counts[c]=-1;
+            }else{
+                res.counts[c]+=static_cast<double>(m.counts[c])/o.runs;
+            }
+        }
+    }
+    std::sort(samples.begin(),samples.end());
+    double sum=0;
+    for(size_t s:samples)sum+=s;
+    res.min=samples.front();
+    res.max=samples.back();
+    res.mean=sum/samples.size();
+    res.p50=percentile(samples,0.5);
+    res.p99=percentile(samples,0.99);
+    res.p999=percentile(samples,0.999);
+    return res;
+}
+
+//reads a value (in kB) from /proc/meminfo, 0 if it is not found
+inline size_t meminfo(const std::string& key){
+    std::ifstream f("/proc/meminfo");
+    std::string name;
+    size_t value;
+    std::string unit;
+    while(f>>name>>value>>unit){
+        if(name==key+":"){
+            return value;
+        }
+    }
+    return 0;
+}
+
+//prints a measured time and, if compiled with REWIRING_STATS, the rewiring operations since the last call
+inline void print_stats(const std::string& name,size_t time){
+    std::cout<<name<<": "<<time<<"ns";
+    if(rewiring_stats::enabled){
+        std::cout<<" ";
+        rewiring_stats::current().print(std::cout);
+    }
+    std::cout<<std::endl;
+    rewiring_stats::reset();
+}
+
+//writes results as CSV (';' separated, like the other benchmarks) or as JSON lines
+//with REWIRING_STATS, the rewiring operations per run are appended (calls, nanoseconds, pages per operation)
+class result_writer{
+    std::ofstream out;
+    bool json;
+
+    void write_stats(const bench_result& r){
+        for(int op=0;op<rewiring_stats::NUM_OPERATIONS;op++){
+            const char* name=rewiring_stats::name(static_cast<rewiring_stats::operation>(op));
+            const auto& s=r.stats.operations[op];
+            if(json){
+                out<<",\""<<name<<"_calls\":"<<static_cast<double>(s.calls)/r.runs<<",\""<<name<<"_ns\":"
+                   <<static_cast<double>(s.nanoseconds)/r.runs<<",\""<<name<<"_pages\":"<<static_cast<double>(s.pages)/r.runs;
+            }else{
+                out<<";"<<static_cast<double>(s.calls)/r.runs<<";"<<static_cast<double>(s.nanoseconds)/r.runs<<";"
+                   <<static_cast<double>(s.pages)/r.runs;
+            }
+        }
+        if(json){
+            out<<",\"mmap_calls\":"<<static_cast<double>(r.stats.mmapCalls)/r.runs<<",\"ioctl_calls\":"
+               <<static_cast<double>(r.stats.ioctlCalls)/r.runs;
+        }else{
+            out<<";"<<static_cast<double>(r.stats.mmapCalls)/r.runs<<";"<<static_cast<double>(r.stats.ioctlCalls)/r.runs;
+        }
+    }
+public:
+    explicit result_writer(const bench_options& o):out(o.out),json(o.format=="json"){
+        if(!json){
+            out<<"bench;backend;size;runs;min;mean;p50;p99;p999;max;page_faults;dtlb_misses;syscalls";
+            if(rewiring_stats::enabled){
+                for(int op=0;op<rewiring_stats::NUM_OPERATIONS;op++){
+                    std::string name=rewiring_stats::name(static_cast<rewiring_stats::operation>(op));
+                    out<<";"<<name<<"_calls;"<<name<<"_ns;"<<name<<"_pages";
+                }
+                out<<";mmap_calls;ioctl_calls";
+            }
+            out<<std::endl;
+        }
+    }
+    void write(const bench_result& r){
+        if(json){
+            out<<"{\"bench\":\""<<r.bench<<"\",\"backend\":\""<<r.backend<<"\",\"size\":"<<r.size<<",\"runs\":"<<r.runs
+               <<",\"min\":"<<r.min<<",\"mean\":"<<r.mean<<",\"p50\":"<<r.p50<<",\"p99\":"<<r.p99<<",\"p999\":"<<r.p999
+               <<",\"max\":"<<r.max<<",\"page_faults\":"<<r.counts[perf_counters::PAGE_FAULTS]
+               <<",\"dtlb_misses\":"<<r.counts[perf_counters::DTLB_MISSES]
+               <<",\"syscalls\":"<<r.counts[perf_counters::SYSCALLS];
+            if(rewiring_stats::enabled){
+                write_stats(r);
+            }
+            out<<"}"<<std::endl;
+        }else{
+            out<<r.bench<<";"<<r.backend<<";"<<r.size<<";"<<r.runs<<";"<<r.min<<";"<<r.mean<<";"<<r.p50<<";"<<r.p99<<";"
+               <<r.p999<<";"<<r.max<<";"<<r.counts[perf_counters::PAGE_FAULTS]<<";"<<r.counts[perf_counters::DTLB_MISSES]<<";"
+               <<r.counts[perf_counters::SYSCALLS];
+            if(rewiring_stats::enabled){
+                write_stats(r);
+            }
+            out<<std::endl;
+        }
+    }
+};
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <memory>
+#include "../lib/rewiring.tcc"
+//values per page of the table
+constexpr size_t values_per_page=4096/sizeof(uint32_t);
+struct result{
+    size_t create;
+    size_t view_scan;
+    size_t gather_scan;
+};
+result bench(bool use_lkm,size_t num_pages,double selectivity){
+    //1. create table: every page stores values_per_page 32 bit values
+    //the view is declared after r -> deleted before the rewiring object, also if an exception is thrown
+    std::unique_ptr<rewiring> r(rewiring::create(use_lkm));
+    r->resize(num_pages);
+    auto* table=static_cast<uint32_t*>(r->getMapping());
+    for(size_t i=0;i<num_pages*values_per_page;i++){
+        table[i]=static_cast<uint32_t>(i);
+    }
+    r->syncFromPT(0,num_pages);
+    //2. select qualifying pages, e.g. as the result of a zone map lookup
+    std::mt19937_64 gen(42);
+    std::bernoulli_distribution qualifies(selectivity);
+    std::vector<size_t> positions;
+    for(size_t i=0;i<num_pages;i++){
+        if(qualifies(gen)){
+            positions.push_back(i);
+        }
+    }
+    //3. measure time for creating the compacted view
+    auto start=std::chrono::steady_clock::now();
+    std::vector<PageId> ids(positions.size());
+    for(size_t i=0;i<positions.size();i++){
+        ids[i]=r->getPageIds()[positions[i]];
+    }
+    std::unique_ptr<rewiring_view> view(r->createView(ids.data(),ids.size()));
+    auto end=std::chrono::steady_clock::now();
+    size_t create=std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    //4. measure time for scanning the view as one contiguous array
+    start=std::chrono::steady_clock::now();
+    auto* compacted=static_cast<const uint32_t*>(view->getMapping());
+    uint64_t viewSum=0;
+    for(size_t i=0;i<positions.size()*values_per_page;i++){
+        viewSum+=compacted[i];
+    }
+    end=std::chrono::steady_clock::now();
+    size_t viewScan=std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    //5. measure time for scanning the qualifying pages of the table page by page
+    start=std::chrono::steady_clock::now();
+    uint64_t gatherSum=0;
+    for(size_t pos:positions){
+        const uint32_t* page=&table[pos*values_per_page];
+        for(size_t i=0;i<values_per_page;i++){
+            gatherSum+=page[i];
+        }
+    }
+    end=std::chrono::steady_clock::now();
+    size_t gatherScan=std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    if(viewSum!=gatherSum)std::cout<<"wrong sum:"<<viewSum<<"!="<<gatherSum<<std::endl;
+    return {create,viewScan,gatherScan};
+}
+void perform_bench(size_t num_pages,double selectivity,std::ofstream& out){
+    //execute every benchmark 10 times and take the minimum
+    for(bool use_lkm:{true,false}){
+        result best{std::numeric_limits<size_t>::max(),std::numeric_limits<size_t>::max(),std::numeric_limits<size_t>::max()};
+        try{
+            for(int i=0;i<10;i++){
+                result res=bench(use_lkm,num_pages,selectivity);
+                best.create=std::min(best.create,res.create);
+                best.view_scan=std::min(best.view_scan,res.view_scan);
+                best.gather_scan=std::min(best.gather_scan,res.gather_scan);
+            }
+        }catch(std::system_error& e){
+            //the mmap-based views are limited by vm.max_map_count
+            std::cerr<<"selectivity "<<selectivity<<": "<<e.what()<<std::endl;
+            continue;
+        }
+        //write to CSV
+        out<<selectivity<<";"<<(use_lkm?"lkm":"mmap")<<";"<<best.create<<";"<<best.view_scan<<";"<<best.gather_scan<<std::endl;
+    }
+}
+int main(){
+    std::ofstream out("result.csv");
+    out<<"selectivity;type;view_create;view_scan;gather_scan"<<std::endl;
+    //table of 1GB, perform benchmark for selectivities of 0.1%, 1%, 10%, 50%
+    size_t num_pages=262144;
+    for(double selectivity:{0.001,0.01,0.1,0.5}){
+        perform_bench(num_pages,selectivity,out);
+    }
+    return 0;
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "rewiring.tcc"
+
+//streaming checkpoint and restore of a rewiring object, its views and all pages they map
+//file format:
+// 1. header
+// 2. for every mapping (main mapping first, then the views): number of pages, then one page index per page
+//    (page indices are dense: 0...num_pages-1, unassigned pages stay PAGEID_UNASSIGNED)
+// 3. the content of all pages, ordered by page index
+struct checkpoint_header{
+    char magic[8];
+    uint64_t num_pages;
+    uint64_t num_mappings;
+};
+//size of the buffers for reading and writing page contents
+constexpr size_t checkpoint_batch_pages=16384;
+constexpr char checkpoint_magic[8]={'R','E','W','I','R','E','C','P'};
+
+//file descriptor of a checkpoint, closed when leaving the scope (also on exceptions)
+class checkpoint_file{
+    int fd;
+public:
+    checkpoint_file(const std::string& path,int flags):fd(open(path.c_str(),flags,0644)){
+        if(fd<0){
+            throw std::system_error(errno, std::generic_category(), "opening of checkpoint failed");
+        }
+    }
+    checkpoint_file(const checkpoint_file&)=delete;
+    checkpoint_file& operator=(const checkpoint_file&)=delete;
+    int get() const {
+        return fd;
+    }
+    size_t size() const {
+        struct stat st;
+        if(fstat(fd,&st)!=0){
+            throw std::system_error(errno, std::generic_category(), "reading checkpoint failed");
+        }
+        return static_cast<size_t>(st.st_size);
+    }
+    ~checkpoint_file(){
+        close(fd);
+    }
+};
+
+inline void checkpoint_write(int fd,const void* data,size_t bytes){
+    const char* ptr=static_cast<const char*>(data);
+    while(bytes>0){
+        ssize_t res=write(fd,ptr,bytes);
+        if(res<0){
+            throw std::system_error(errno, std::generic_category(), "writing checkpoint failed");
+        }
+        ptr+=res;
+        bytes-=res;
+    }
+}
+inline void checkpoint_read(int fd,void* data,size_t bytes){
+    char* ptr=static_cast<char*>(data);
+    while(bytes>0){
+        ssize_t res=read(fd,ptr,bytes);
+        if(res<0){
+            throw std::system_error(errno, std::generic_category(), "reading checkpoint failed");
+        }
+        if(res==0){
+            throw std::runtime_error("checkpoint file is truncated");
+        }
+        ptr+=res;
+        bytes-=res;
+    }
+}
+
+//writes all pages mapped by r and the given views together with their page id tables to a file
+inline void checkpoint_rewiring(rewiring* r,const std::vector<rewiring_view*>& views,const std::string& path){
+    std::vector<rewiring_view*> mappings{r};
+    mappings.insert(mappings.end(),views.begin(),views.end());
+    //fetch current page ids and determine the largest one
+    PageId maxId=0;
+    for(rewiring_view* m:mappings){
+        m->syncFromPT(0,m->getNumPages());
+        for(size_t i=0;i<m->getNumPages();i++){
+            PageId id=m->getPageIds()[i];
+            if(id!=PAGEID_UNASSIGNED){
+                maxId=std::max(maxId,id);
+            }
+        }
+    }
+    //assign dense indices to all mapped pages, remember where their content can be read
+    std::vector<PageId> index(static_cast<size_t>(maxId)+1,PAGEID_UNASSIGNED);
+    std::vector<const Page*> sources;
+    std::vector<std::vector<PageId>> tables;
+    for(rewiring_view* m:mappings){
+        std::vector<PageId> table(m->getNumPages());
+        for(size_t i=0;i<m->getNumPages();i++){
+            PageId id=m->getPageIds()[i];
+            if(id==PAGEID_UNASSIGNED){
+                table[i]=PAGEID_UNASSIGNED;
+                continue;
+            }
+            if(index[id]==PAGEID_UNASSIGNED){
+                index[id]=sources.size();
+                sources.push_back(&static_cast<const Page*>(m->getMapping())[i]);
+            }
+            table[i]=index[id];
+        }
+        tables.push_back(std::move(table));
+    }
+    checkpoint_file file(path,O_WRONLY|O_CREAT|O_TRUNC);
+    int fd=file.get();
+    checkpoint_header header{};
+    std::memcpy(header.magic,checkpoint_magic,sizeof(header.magic));
+    header.num_pages=sources.size();
+    header.num_mappings=mappings.size();
+    checkpoint_write(fd,&header,sizeof(header));
+    for(auto& table:tables){
+        uint64_t pages=table.size();
+        checkpoint_write(fd,&pages,sizeof(pages));
+        checkpoint_write(fd,table.data(),pages*sizeof(PageId));
+    }
+    //stream page contents: gather them into a buffer and write it with one call
+    std::vector<Page> buffer(std::min(checkpoint_batch_pages,sources.size()));
+    for(size_t i=0;i<sources.size();i+=buffer.size()){
+        size_t batch=std::min(buffer.size(),sources.size()-i);
+        for(size_t j=0;j<batch;j++){
+            buffer[j]=*sources[i+j];
+        }
+        checkpoint_write(fd,buffer.data(),batch*sizeof(Page));
+    }
+}
+
+//restores a checkpoint into a freshly created rewiring object
+//resizes the main mapping of r and returns the restored views (to be deleted by the caller, before r)
+//throws std::runtime_error for files that are no (complete) checkpoint, nothing is mapped then
+inline std::vector<rewiring_view*> restore_rewiring(rewiring* r,const std::string& path){
+    checkpoint_file file(path,O_RDONLY);
+    int fd=file.get();
+    //all counts are checked against the file size before anything is allocated
+    size_t remaining=file.size();
+    checkpoint_header header;
+    if(remaining<sizeof(header)){
+        throw std::runtime_error("not a rewiring checkpoint");
+    }
+    checkpoint_read(fd,&header,sizeof(header));
+    remaining-=sizeof(header);
+    if(std::memcmp(header.magic,checkpoint_magic,sizeof(header.magic))!=0||header.num_mappings==0){
+        throw std::runtime_error("not a rewiring checkpoint");
+    }
+    if(header.num_pages>remaining/rewiring::page_size||header.num_pages>=PAGEID_OFFSET_INVALID
+       ||header.num_mappings>remaining/sizeof(uint64_t)){
+        throw std::runtime_error("corrupt checkpoint: invalid header");
+    }
+    remaining-=header.num_pages*rewiring::page_size;
+    std::vector<std::vector<PageId>> tables(header.num_mappings);
+    for(auto& table:tables){
+        uint64_t pages;
+        if(remaining<sizeof(pages)){
+            throw std::runtime_error("checkpoint file is truncated");
+        }
+        checkpoint_read(fd,&pages,sizeof(pages));
+        remaining-=sizeof(pages);
+        if(pages>remaining/sizeof(PageId)){
+            throw std::runtime_error("corrupt checkpoint: invalid number of pages");
+        }
+        table.resize(pages);
+        checkpoint_read(fd,table.data(),pages*sizeof(PageId));
+        remaining-=pages*sizeof(PageId);
+        for(PageId id:table){
+            if(id!=PAGEID_UNASSIGNED&&id>=header.num_pages){
+                throw std::runtime_error("corrupt checkpoint: invalid page index");
+            }
+        }
+    }
+    //allocate all pages in one go
+    std::vector<PageId> ids(header.num_pages);
+    std::vector<size_t> positions(header.num_pages);
+    for(size_t i=0;i<positions.size();i++){
+        positions[i]=i;
+    }
+    r->createNewPageIds(ids.size(),positions.data(),ids.data());
+    //map all pages in order and read their contents with large sequential reads
+    if(!ids.empty()){
+        std::unique_ptr<rewiring_view> staging(r->createView(ids.data(),ids.size()));
+        auto* dest=static_cast<char*>(staging->getMapping());
+        for(size_t i=0;i<ids.size();i+=checkpoint_batch_pages){
+            size_t batch=std::min(checkpoint_batch_pages,ids.size()-i);
+            checkpoint_read(fd,dest+i*rewiring::page_size,batch*rewiring::page_size);
+        }
+    }
+    //translate page indices to the new page ids
+    for(auto& table:tables){
+        for(PageId& id:table){
+            if(id!=PAGEID_UNASSIGNED){
+                id=ids[id];
+            }
+        }
+    }
+    //set up the main mapping with a single SET_PAGE_IDS and recreate the views
+    r->resize(tables[0].size());
+    std::memcpy(r->getPageIds(),tables[0].data(),tables[0].size()*sizeof(PageId));
+    r->syncToPT(0,tables[0].size());
+    std::vector<std::unique_ptr<rewiring_view>> restored;
+    for(size_t i=1;i<tables.size();i++){
+        restored.emplace_back(r->createView(tables[i].data(),tables[i].size()));
+    }
+    std::vector<rewiring_view*> views;
+    for(auto& view:restored){
+        views.push_back(view.release());
+    }
+    return views;
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <cstring>
+#include <algorithm>
+#include <climits>
+#include <vector>
 #include <linux/memfd.h>
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -9,6 +12,86 @@
 #include <sys/ioctl.h>
 
 #include "../module/inc/communication.h"
+//sends a rewiring command concerning the mapping to the kernel module
+inline void lkm_command(int fd,cmd_types type,void* mapping,size_t start,size_t len,void* payload){
+    struct cmd command = {
+            .type=type,
+            .start=start,
+            .len=len,
+            .mapping_start=mapping,
+            .payload=payload,
+    };
+    REWIRING_STATS_COUNT(ioctlCalls);
+    if(ioctl(fd,REW_CMD,&command)!=0){
+        throw std::system_error(errno, std::generic_category(), "ioctl failed");
+    }
+}
+//encodes page ids as runs of arithmetic sequences (consecutive pages, repeated pages, strides)
+//gives up and returns false as soon as the runs would not be considerably smaller than the plain page ids
+inline bool encode_page_ids(const PageId* ids,size_t len,std::vector<page_id_run>& runs){
+    //the encoding has to save at least half of the transferred bytes
+    size_t maxRuns=len*sizeof(PageId)/(2*sizeof(page_id_run));
+    runs.clear();
+    size_t i=0;
+    while(i<len){
+        if(runs.size()==maxRuns){
+            return false;
+        }
+        page_id_run run{ids[i],0,1};
+        if(i+1<len){
+            long stride=static_cast<long>(ids[i+1])-static_cast<long>(ids[i]);
+            //unassigned pages can only be repeated
+            bool unassigned=ids[i]==PAGEID_UNASSIGNED||ids[i+1]==PAGEID_UNASSIGNED;
+            if(stride>=INT_MIN&&stride<=INT_MAX&&(!unassigned||stride==0)){
+                run.stride=static_cast<int>(stride);
+                while(i+run.count<len&&ids[i+run.count]==ids[i+run.count-1]+run.stride
+                      &&(run.stride==0||ids[i+run.count]!=PAGEID_UNASSIGNED)){
+                    run.count++;
+                }
+            }
+        }
+        runs.push_back(run);
+        i+=run.count;
+    }
+    return true;
+}
+//sets page ids of a mapping, uses the encoded command if this saves transferring the page ids
+inline void lkm_set_page_ids(int fd,void* mapping,size_t start,size_t len,PageId* ids){
+    std::vector<page_id_run> runs;
+    if(encode_page_ids(ids,len,runs)){
+        lkm_command(fd,SET_PAGE_IDS_ENCODED,mapping,start,runs.size(),runs.data());
+    }else{
+        lkm_command(fd,SET_PAGE_IDS,mapping,start,len,ids);
+    }
+}
+//additional mapping of /dev/rewiring, shares the page pool (file) with a lkm_rewiring object
+class lkm_view: public rewiring_view{
+    int fd;
+public:
+    lkm_view(int fd,size_t pages):rewiring_view(),fd(fd){
+        //every mmap of the same file creates a new mapping over the same page pool
+        REWIRING_STATS_COUNT(mmapCalls);
+        mapping = mmap(NULL, pages * page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        check_mmap_result(mapping);
+        num_pages=pages;
+        //a fresh mapping has no pages assigned
+        pageIds=new PageId[pages];
+        std::fill(pageIds,pageIds+pages,PAGEID_UNASSIGNED);
+    }
+    virtual void syncFromPT(size_t start,size_t len){
+        REWIRING_STATS_SCOPE(SYNC_FROM_PT,len);
+        lkm_command(fd,GET_PAGE_IDS,mapping,start,len,&pageIds[start]);
+    }
+    virtual void syncToPT(size_t start,size_t len){
+        REWIRING_STATS_SCOPE(SYNC_TO_PT,len);
+        lkm_set_page_ids(fd,mapping,start,len,&pageIds[start]);
+    }
+    ~lkm_view(){
+        //cleanup -> unmap mapping, free pageid array (the file belongs to the lkm_rewiring object)
+        check_munmap_result(munmap(mapping,num_pages*page_size));
+        delete[] pageIds;
+    }
+};
 class lkm_rewiring: public rewiring{
     int fd;
 
@@ -22,6 +105,7 @@ public:
         }
     }
     virtual void resize(size_t pages){
+        REWIRING_STATS_SCOPE(RESIZE,pages);
         size_t oldNumPages=num_pages;
         //before resizing: fetch current state from module
         syncFromPT(0,num_pages);
@@ -39,11 +123,12 @@ public:
         pageIds=newPageIds;
         num_pages=pages;
         //create new mapping
+        REWIRING_STATS_COUNT(mmapCalls);
         mapping = mmap(NULL, pages * page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
         check_mmap_result(mapping);
-        //sync additional page ids from kernel module
+        //a fresh mapping has no pages assigned -> no need to fetch the additional page ids
         if(oldNumPages<pages) {
-            syncFromPT(oldNumPages,num_pages-oldNumPages);
+            std::fill(pageIds+oldNumPages,pageIds+pages,PAGEID_UNASSIGNED);
         }
         //sync old page ids to the kernel module
         if(oldNumPages>0) {
@@ -52,48 +137,59 @@ public:
     }
     virtual void syncFromPT(size_t start,size_t len){
         //send "GET_PAGE_IDS" to kernel module
+        REWIRING_STATS_SCOPE(SYNC_FROM_PT,len);
         if(mapping) {
-            struct cmd getPagesCMD = {
-                    .type=GET_PAGE_IDS,
-                    .start=start,
-                    .len=len,
-                    .mapping_start=mapping,
-                    .payload=&pageIds[start],
-            };
-
-            if(ioctl(fd, REW_CMD, &getPagesCMD)!=0){
-                throw std::system_error(errno, std::generic_category(), "ioctl failed");
-            }
+            lkm_command(fd,GET_PAGE_IDS,mapping,start,len,&pageIds[start]);
         }
 
     };
     virtual void syncToPT(size_t start,size_t len){
-        //send "SET_PAGE_IDS" command to kernel module, with correct parameters
-        struct cmd setPagesCMD = {
-                .type=SET_PAGE_IDS,
-                .start=start,
-                .len=len,
-                .mapping_start=mapping,
-                .payload=&pageIds[start],
-        };
-        if(ioctl(fd,REW_CMD,&setPagesCMD)!=0){
-            throw std::system_error(errno, std::generic_category(), "ioctl failed");
-        }
-
+        //send "SET_PAGE_IDS" (or "SET_PAGE_IDS_ENCODED") command to kernel module, with correct parameters
+        REWIRING_STATS_SCOPE(SYNC_TO_PT,len);
+        lkm_set_page_ids(fd,mapping,start,len,&pageIds[start]);
     }
     virtual void createNewPageIds(size_t num,size_t* /*positions*/,PageId* array){
         //send "CREATE_PAGE_IDS" command to kernel module with right parameters
-        struct cmd createPageIds = {
-                .type=CREATE_PAGE_IDS,
-                .start=0,
-                .len=num,
-                .mapping_start=mapping,
-                .payload=array,
-        };
-        if(ioctl(fd,REW_CMD,&createPageIds)!=0){
-            throw std::system_error(errno, std::generic_category(), "ioctl failed");
-        }
+        REWIRING_STATS_SCOPE(CREATE_PAGE_IDS,num);
+        lkm_command(fd,CREATE_PAGE_IDS,mapping,0,num,array);
+    }
+    virtual rewiring_view* createView(size_t pages){
+        return new lkm_view(fd,pages);
+    }
+    //merges pages with identical content, returns the number of freed pages
+    //shared pages are copied again on the first write
+    //page ids of views (and ids stored elsewhere) have to be fetched again afterwards
+    size_t deduplicate(){
+        unsigned long freed=0;
+        lkm_command(fd,DEDUP_PAGES,mapping,0,0,&freed);
+        syncFromPT(0,num_pages);
+        return freed;
+    }
+    //makes pages reclaimable: at most residentLimit pages (0: no limit) are kept in memory,
+    //the others are evicted to the file backingFd (opened read/write, e.g. on zram) and read back on access
+    //pages are accounted to the memory cgroup from now on
+    void enableReclaim(int backingFd,size_t residentLimit){
+        lkm_command(fd,CONFIGURE_RECLAIM,mapping,backingFd,residentLimit,nullptr);
+    }
+    //evicts up to the given number of least recently used pages, returns the number of evicted pages
+    size_t evict(size_t pages){
+        unsigned long evicted=0;
+        lkm_command(fd,EVICT_PAGES,mapping,0,pages,&evicted);
+        return evicted;
+    }
+    //creates num new page ids whose pages are filled with num*page_size bytes of buffer
+    //the pages are filled by the kernel module, no page is faulted in
+    void createPageIdsFromBuffer(size_t num,const void* buffer,PageId* array){
+        write_pages_args args{buffer,-1,0,array};
+        lkm_command(fd,WRITE_PAGES,mapping,0,num,&args);
+    }
+    //creates num new page ids whose pages are read from file descriptor sourceFd starting at offset
+    //(pages behind the end of the file are zero)
+    void createPageIdsFromFile(size_t num,int sourceFd,size_t offset,PageId* array){
+        write_pages_args args{nullptr,sourceFd,offset,array};
+        lkm_command(fd,WRITE_PAGES,mapping,0,num,&args);
     }
+    using rewiring::createView;
 
     ~lkm_rewiring(){
         //cleanup -> unmap mapping, close fd, free pageid array
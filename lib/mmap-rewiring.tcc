@@ -7,6 +7,64 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include <sys/types.h>
+//update mapping by creating as much mmaps as required
+inline void mmap_sync_to_pt(int fd,void* mapping,const PageId* pageIds,size_t start,size_t len){
+    Page* mapping_= static_cast<Page *>(mapping);
+    //try to "squeeze" as much pages into one mmap call as possible
+    //->increment delayed and proceed with next page
+    size_t delayed=0;
+
+    for(size_t i=0;i<len;i++) {
+        bool unassigned=pageIds[start+i]==PAGEID_UNASSIGNED;
+        //can we delay the mmap call?
+        if((i+1<len)&&(unassigned?pageIds[start+i+1]==PAGEID_UNASSIGNED:pageIds[start+i]+1==pageIds[start+i+1])){
+            //yes -> only increment delayed
+            delayed++;
+            continue;
+        }
+        //no: call mmap for delayed+1 pages
+        //unassigned pages are backed by anonymous memory (zero pages, like unassigned pages of the kernel module)
+        REWIRING_STATS_COUNT(mmapCalls);
+        void* res=unassigned?
+                  mmap(&mapping_[start+i-delayed], rewiring::page_size * (1+delayed), PROT_READ | PROT_WRITE,
+                       MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0):
+                  mmap(&mapping_[start+i-delayed], rewiring::page_size * (1+delayed), PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fd,
+                       pageIds[start+i-delayed] * rewiring::page_size);
+        if(res==MAP_FAILED){
+            throw std::system_error(errno, std::generic_category(), "mmap failed");
+        }
+        //reset delayed
+        delayed=0;
+    }
+}
+//additional mapping of the main memory file, shares the page pool with a mmap_rewiring object
+class mmap_view: public rewiring_view{
+    int fd;
+public:
+    mmap_view(int fd,size_t pages):rewiring_view(),fd(fd){
+        REWIRING_STATS_COUNT(mmapCalls);
+        mapping = mmap(NULL, pages * page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        check_mmap_result(mapping);
+        num_pages=pages;
+        //a fresh mapping maps the file linearly
+        pageIds=new PageId[pages];
+        for(size_t i=0;i<pages;i++){
+            pageIds[i]=i;
+        }
+    }
+    virtual void syncFromPT(size_t /*start*/,size_t /*len*/){
+        //for mmap-based mapping, there is no external state
+    }
+    virtual void syncToPT(size_t start,size_t len){
+        REWIRING_STATS_SCOPE(SYNC_TO_PT,len);
+        mmap_sync_to_pt(fd,mapping,pageIds,start,len);
+    }
+    ~mmap_view(){
+        //cleanup: unmap mapping, free page id array (the file belongs to the mmap_rewiring object)
+        check_munmap_result(munmap(mapping,num_pages*page_size));
+        delete[] pageIds;
+    }
+};
 class mmap_rewiring: public rewiring{
     int fd;
 public:
@@ -22,6 +80,7 @@ public:
         }
     }
     virtual void resize(size_t pages){
+        REWIRING_STATS_SCOPE(RESIZE,pages);
         size_t oldNumPages=num_pages;
         if(mapping!=NULL) {
             //unmap old mapping
@@ -40,6 +99,7 @@ public:
         pageIds=newPageIds;
         num_pages=pages;
         //create new larger mapping
+        REWIRING_STATS_COUNT(mmapCalls);
         mapping = mmap(NULL, pages * page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
         check_mmap_result(mapping);
         //redo "rewire" using the stored page ids
@@ -49,33 +109,21 @@ public:
         //for mmap-based mapping, there is no external state
     };
     virtual void syncToPT(size_t start,size_t len){
-        //update mapping by creating as much mmaps as required
-        Page* mapping_= static_cast<Page *>(mapping);
-        //try to "squeeze" as much pages into one mmap call as possible
-        //->increment delayed and proceed with next page
-        size_t delayed=0;
-
-        for(size_t i=0;i<len;i++) {
-            //can we delay the mmap call?
-            if((i+1<len)&&pageIds[start+i]+1==pageIds[start+i+1]){
-                //yes -> only increment delayed
-                delayed++;
-                continue;
-            }
-            //no: call mmap for delayed+1 pages
-            check_mmap_result(mmap(&mapping_[start+i-delayed], page_size * (1+delayed), PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fd,
-                             pageIds[start+i-delayed] * page_size));
-            //reset delayed
-            delayed=0;
-        }
+        REWIRING_STATS_SCOPE(SYNC_TO_PT,len);
+        mmap_sync_to_pt(fd,mapping,pageIds,start,len);
     }
     virtual void createNewPageIds(size_t num,size_t* positions,PageId* array){
         //for mmap-based mapping, there is no "explicit" way for "creating" page ids
         //to create a mostly linear mapping: use provided positions as page ids
+        REWIRING_STATS_SCOPE(CREATE_PAGE_IDS,num);
         for(size_t i=0;i<num;i++){
             array[i]=positions[i];
         }
     }
+    virtual rewiring_view* createView(size_t pages){
+        return new mmap_view(fd,pages);
+    }
+    using rewiring::createView;
 
     ~mmap_rewiring(){
         //cleanup: unmap mapping,close file decriptor, free page id array
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <cstring>
+#include "rewiring.tcc"
+
+//hands out page ids of a rewiring object and recycles page ids that are no longer needed
+//the ids of released pages are handed out again before new ones are created
+class page_pool{
+    //rewiring object, the page ids belong to
+    rewiring* r;
+    //page ids that were released and can be reused
+    std::vector<PageId> freeIds;
+    //next position passed to createNewPageIds
+    //the mmap-based rewiring uses positions as page ids -> positions must never repeat
+    size_t nextPosition;
+public:
+    explicit page_pool(rewiring* r):r(r),freeIds(),nextPosition(0){}
+
+    //stores num page ids into array, prefers recycled page ids
+    void acquire(size_t num,PageId* array){
+        size_t recycled=std::min(num,freeIds.size());
+        std::memcpy(array,freeIds.data()+freeIds.size()-recycled,recycled*sizeof(PageId));
+        freeIds.resize(freeIds.size()-recycled);
+        size_t fresh=num-recycled;
+        if(fresh>0){
+            //create the missing page ids in one go
+            std::vector<size_t> positions(fresh);
+            for(size_t i=0;i<fresh;i++){
+                positions[i]=nextPosition++;
+            }
+            r->createNewPageIds(fresh,positions.data(),&array[recycled]);
+        }
+    }
+    //returns num page ids to the pool, the pages must not be used anymore
+    void release(size_t num,const PageId* array){
+        freeIds.insert(freeIds.end(),array,array+num);
+    }
+
+    size_t getNumFree() const {
+        return freeIds.size();
+    }
+};
@@ -2,14 +2,97 @@
 #include<cstdint>
 #include <sys/mman.h>
 #include <cerrno>
+#include <cstring>
 #include <system_error>
+#include <chrono>
+#include <memory>
+#include <ostream>
 //definitions for simplifications
 typedef uint32_t PageId;
 typedef struct {
     char data[4096];
 } Page;
-//abstract base class for rewiring
-class rewiring{
+//counters and timers of the rewiring operations of all rewiring objects (process-wide)
+//only collected if compiled with -DREWIRING_STATS (cmake -DREWIRING_STATS=ON), otherwise all counters stay zero
+//and the instrumentation compiles to nothing
+struct rewiring_stats{
+    enum operation{
+        SYNC_TO_PT,SYNC_FROM_PT,RESIZE,CREATE_PAGE_IDS,STAGE_REWIRING,COMMIT_REWIRINGS,NUM_OPERATIONS
+    };
+    struct operation_stats{
+        //number of calls, accumulated latency and number of pages passed to the calls
+        //nested calls (e.g. the syncToPT inside resize) are counted separately
+        size_t calls;
+        size_t nanoseconds;
+        size_t pages;
+    };
+    operation_stats operations[NUM_OPERATIONS];
+    //system calls issued by the backends
+    size_t mmapCalls;
+    size_t ioctlCalls;
+
+#ifdef REWIRING_STATS
+    static constexpr bool enabled=true;
+#else
+    static constexpr bool enabled=false;
+#endif
+    static rewiring_stats& current(){
+        static rewiring_stats stats{};
+        return stats;
+    }
+    static void reset(){
+        current()=rewiring_stats{};
+    }
+    static const char* name(operation op){
+        static const char* names[NUM_OPERATIONS]={"syncToPT","syncFromPT","resize","createNewPageIds","stage_rewiring","commit_rewirings"};
+        return names[op];
+    }
+    //counters collected since the snapshot before was taken
+    rewiring_stats since(const rewiring_stats& before) const {
+        rewiring_stats res=*this;
+        for(int op=0;op<NUM_OPERATIONS;op++){
+            res.operations[op].calls-=before.operations[op].calls;
+            res.operations[op].nanoseconds-=before.operations[op].nanoseconds;
+            res.operations[op].pages-=before.operations[op].pages;
+        }
+        res.mmapCalls-=before.mmapCalls;
+        res.ioctlCalls-=before.ioctlCalls;
+        return res;
+    }
+    //prints all counters as key=value pairs, operations without calls are skipped
+    void print(std::ostream& out) const {
+        for(int op=0;op<NUM_OPERATIONS;op++){
+            if(operations[op].calls>0){
+                out<<name(static_cast<operation>(op))<<"="<<operations[op].calls<<" calls/"<<operations[op].nanoseconds<<"ns/"
+                   <<operations[op].pages<<" pages ";
+            }
+        }
+        out<<"mmap="<<mmapCalls<<" ioctl="<<ioctlCalls;
+    }
+};
+#ifdef REWIRING_STATS
+//measures the enclosing scope as one call of an operation
+class rewiring_stats_scope{
+    rewiring_stats::operation op;
+    std::chrono::steady_clock::time_point start;
+public:
+    rewiring_stats_scope(rewiring_stats::operation op,size_t pages):op(op),start(std::chrono::steady_clock::now()){
+        rewiring_stats::current().operations[op].calls++;
+        rewiring_stats::current().operations[op].pages+=pages;
+    }
+    ~rewiring_stats_scope(){
+        auto end=std::chrono::steady_clock::now();
+        rewiring_stats::current().operations[op].nanoseconds+=std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    }
+};
+#define REWIRING_STATS_SCOPE(op,pages) rewiring_stats_scope rewiringStatsScope(rewiring_stats::op,pages)
+#define REWIRING_STATS_COUNT(counter) (rewiring_stats::current().counter++)
+#else
+#define REWIRING_STATS_SCOPE(op,pages) do{}while(0)
+#define REWIRING_STATS_COUNT(counter) do{}while(0)
+#endif
+//a virtual memory area whose pages are mapped to physical pages via page ids
+class rewiring_view{
 protected:
     //start of mapping
     void* mapping = nullptr;
@@ -18,13 +101,13 @@ protected:
     //a page id array that stores the mapping in a suitable form
     PageId* pageIds = nullptr;
     //check if mmap call worked, if not -> throw exception
-    void check_mmap_result(void* res){
+    static void check_mmap_result(void* res){
         if(res==MAP_FAILED){
             throw std::system_error(errno, std::generic_category(), "mmap failed");
         }
     }
     //check if munmap call worked, ifn not -> throw exception
-    void check_munmap_result( int res){
+    static void check_munmap_result( int res){
         if(res!=0){
             throw std::system_error(errno, std::generic_category(), "munmap failed");
         }
@@ -34,11 +117,9 @@ public:
     static constexpr size_t page_size=4096;
 
     //virtual functions to be implemented by the concrete rewiring class
-    virtual void resize(size_t pages)=0;
     virtual void syncFromPT(size_t start,size_t len)=0;
     virtual void syncToPT(size_t start,size_t len)=0;
-    virtual void createNewPageIds(size_t num,size_t* positions,PageId* array)=0;
-    virtual ~rewiring() = default;
+    virtual ~rewiring_view() = default;
 
     size_t getNumPages() const {
         return num_pages;
@@ -51,6 +132,27 @@ public:
     PageId *getPageIds() const {
         return pageIds;
     }
+};
+//abstract base class for rewiring
+//manages a pool of physical pages (page ids) and a resizable main mapping
+class rewiring: public rewiring_view{
+public:
+    //virtual functions to be implemented by the concrete rewiring class
+    virtual void resize(size_t pages)=0;
+    virtual void createNewPageIds(size_t num,size_t* positions,PageId* array)=0;
+    //creates an additional mapping with the given number of pages over the page pool of this object
+    //the view must be deleted before this object
+    virtual rewiring_view* createView(size_t pages)=0;
+
+    //creates an additional mapping that maps the given page ids in the given order
+    //e.g. a sorted or filtered view of pages of the main mapping
+    rewiring_view* createView(const PageId* ids,size_t pages){
+        //the view is only handed out, if the page ids could be mapped
+        std::unique_ptr<rewiring_view> view(createView(pages));
+        std::memcpy(view->getPageIds(),ids,pages*sizeof(PageId));
+        view->syncToPT(0,pages);
+        return view.release();
+    }
     //static method for creating a rewiring object, if wished (and module inserted)-> lkm-based, otherwise mmap-based
     static rewiring* create(bool use_lkm=true);
 };
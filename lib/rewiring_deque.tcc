@@ -0,0 +1,309 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "rewiring.tcc"
+#include "page_pool.tcc"
+
+//double-ended queue whose elements are stored contiguously in a rewired ring of pages
+//the mapping consists of two halves of ringPages pages: page i and page i+ringPages always map the same page id (mirror),
+//so the elements stay contiguous when they wrap around the end of the ring
+//pushing only maps the pages at the boundaries (a few pages ahead, with page ids recycled from popped pages),
+//the elements themselves are never copied page by page:
+// * the ring grows by doubling inside a virtual range that is reserved up front, only the mirror of the used pages is remapped
+// * when the front passes the mirror, the element pointers jump back by one ring
+//   (trivially copyable elements keep their bytes, other elements are move-constructed to their new address)
+//push/pop are amortized O(1), but single operations are not bounded: the push that grows the ring remaps
+//the mirror of all used pages (O(used pages) page table updates), and for non-trivially copyable T
+//every ring jump move-constructs all elements (O(size())). bench/deque_latency reports the max latency of both
+template<typename T>
+class rewiring_deque{
+    static_assert(sizeof(T)<=rewiring::page_size,"elements larger than a page are not supported");
+    static_assert(rewiring::page_size%alignof(T)==0,"over-aligned types are not supported");
+
+    //rewiring "manager", owns the mapping
+    rewiring* r;
+    //source for page ids, pages that become empty are returned and reused at the other end
+    page_pool pool;
+    //number of pages of the ring (mapping = 2*ringPages, mirrored)
+    size_t ringPages;
+    //maximal number of pages of the ring (the virtual range is reserved for it)
+    size_t maxRingPages;
+    //pages with page ids: [popBegin,popEnd), popBegin<ringPages, popEnd-popBegin<=ringPages
+    size_t popBegin;
+    size_t popEnd;
+    //elements: [first,last)
+    T* first;
+    T* last;
+
+    char* base() const {
+        return static_cast<char*>(r->getMapping());
+    }
+    //page containing byte ptr
+    size_t pageOf(const void* ptr) const {
+        return (static_cast<const char*>(ptr)-base())/rewiring::page_size;
+    }
+    //first page behind byte ptr (rounded up)
+    size_t pageAfter(const void* ptr) const {
+        return (static_cast<const char*>(ptr)-base()+rewiring::page_size-1)/rewiring::page_size;
+    }
+    //writes the page ids of [start,start+len) to the page table and mirrors them to the other half
+    void mapPages(size_t start,size_t len){
+        PageId* ids=r->getPageIds();
+        while(len>0){
+            //split at the border between the two halves
+            size_t n=start<ringPages?std::min(len,ringPages-start):len;
+            size_t mirror=start<ringPages?start+ringPages:start-ringPages;
+            std::memcpy(&ids[mirror],&ids[start],n*sizeof(PageId));
+            r->syncToPT(start,n);
+            r->syncToPT(mirror,n);
+            start+=n;
+            len-=n;
+        }
+    }
+    //doubles the ring, the pages with page ids keep their position -> element addresses stay valid
+    void growRing(){
+        if(2*ringPages>maxRingPages){
+            throw std::length_error("rewiring_deque: maximal capacity exceeded");
+        }
+        ringPages*=2;
+        //popBegin<=old ringPages and popEnd<=popBegin+old ringPages: all populated pages lie in the first half of the new ring
+        PageId* ids=r->getPageIds();
+        std::memcpy(&ids[popBegin+ringPages],&ids[popBegin],(popEnd-popBegin)*sizeof(PageId));
+        r->syncToPT(popBegin+ringPages,popEnd-popBegin);
+    }
+    //moves all element pointers by one ring (pages=+-ringPages), the memory below is the same because of the mirror
+    void shift(long pages){
+        long bytes=pages*static_cast<long>(rewiring::page_size);
+        T* newFirst=reinterpret_cast<T*>(reinterpret_cast<char*>(first)+bytes);
+        if(!std::is_trivially_copyable<T>::value){
+            //the bytes already appear at the new address, but the objects may point to themselves
+            for(T *src=first,*dest=newFirst;src!=last;++src,++dest){
+                T tmp(std::move(*src));
+                src->~T();
+                new(dest) T(std::move(tmp));
+            }
+        }
+        last=newFirst+(last-first);
+        first=newFirst;
+        popBegin+=pages;
+        popEnd+=pages;
+    }
+    //number of pages to map before/behind the elements at once
+    static constexpr size_t batch_pages=16;
+
+    //maps pages behind popEnd until page end is mapped
+    void populateBack(size_t end){
+        size_t needed=end-popEnd;
+        while(popEnd-popBegin+needed>ringPages){
+            growRing();
+        }
+        size_t n=std::min(std::max(needed,batch_pages),ringPages-(popEnd-popBegin));
+        pool.acquire(n,&r->getPageIds()[popEnd]);
+        mapPages(popEnd,n);
+        popEnd+=n;
+    }
+    //maps pages before popBegin until page start is mapped
+    void populateFront(size_t start){
+        size_t needed=popBegin-start;
+        while(popEnd-popBegin+needed>ringPages){
+            growRing();
+        }
+        size_t n=std::min({std::max(needed,batch_pages),ringPages-(popEnd-popBegin),popBegin});
+        pool.acquire(n,&r->getPageIds()[popBegin-n]);
+        mapPages(popBegin-n,n);
+        popBegin-=n;
+    }
+    //makes room for one element behind last
+    void reserveBack(){
+        size_t end=pageAfter(last+1);
+        if(end>popEnd){
+            populateBack(end);
+        }
+    }
+    //makes room for one element before first
+    void reserveFront(){
+        if(reinterpret_cast<char*>(first)-base()<static_cast<long>(sizeof(T))){
+            //front reached the start of the mapping (popBegin=0, popEnd<=ringPages) -> continue in the mirror
+            shift(ringPages);
+        }
+        size_t start=pageOf(first-1);
+        if(start<popBegin){
+            populateFront(start);
+        }
+    }
+    //returns pages that are no longer needed to the pool, keeps a batch for pushing again
+    void releaseFront(){
+        size_t empty=pageOf(first)-popBegin;
+        if(empty>2*batch_pages){
+            size_t n=empty-batch_pages;
+            pool.release(n,&r->getPageIds()[popBegin]);
+            popBegin+=n;
+        }
+        if(popBegin>=ringPages){
+            //front passed the mirror -> continue in the first half
+            shift(-static_cast<long>(ringPages));
+        }
+    }
+    void releaseBack(){
+        size_t empty=popEnd-pageAfter(last);
+        if(empty>2*batch_pages){
+            size_t n=empty-batch_pages;
+            popEnd-=n;
+            pool.release(n,&r->getPageIds()[popEnd]);
+        }
+    }
+
+public:
+    using value_type=T;
+    using size_type=size_t;
+    using difference_type=std::ptrdiff_t;
+    using reference=T&;
+    using const_reference=const T&;
+    using iterator=T*;
+    using const_iterator=const T*;
+    using reverse_iterator=std::reverse_iterator<iterator>;
+    using const_reverse_iterator=std::reverse_iterator<const_iterator>;
+
+    //initial size of the ring (pages)
+    static constexpr size_t initial_ring_pages=64;
+    //default maximal size of the ring (8 GiB), the mapping reserves twice as much virtual memory
+    static constexpr size_t default_max_ring_pages=1ull<<21;
+
+    explicit rewiring_deque(bool use_lkm=true,size_t maxRingPages=default_max_ring_pages)
+            :r(rewiring::create(use_lkm)),pool(r),ringPages(std::min(initial_ring_pages,maxRingPages)),maxRingPages(maxRingPages){
+        //reserve the virtual range once, growing the ring never moves the mapping
+        r->resize(2*maxRingPages);
+        popBegin=popEnd=ringPages/2;
+        first=last=reinterpret_cast<T*>(base()+popBegin*rewiring::page_size);
+    }
+    rewiring_deque(const rewiring_deque&)=delete;
+    rewiring_deque& operator=(const rewiring_deque&)=delete;
+
+    template<typename... Args>
+    T& emplace_back(Args&&... args){
+        reserveBack();
+        new(last) T(std::forward<Args>(args)...);
+        return *(last++);
+    }
+    template<typename... Args>
+    T& emplace_front(Args&&... args){
+        reserveFront();
+        new(first-1) T(std::forward<Args>(args)...);
+        return *(--first);
+    }
+    void push_back(const T& value){
+        emplace_back(value);
+    }
+    void push_back(T&& value){
+        emplace_back(std::move(value));
+    }
+    void push_front(const T& value){
+        emplace_front(value);
+    }
+    void push_front(T&& value){
+        emplace_front(std::move(value));
+    }
+    void pop_back(){
+        (--last)->~T();
+        releaseBack();
+    }
+    void pop_front(){
+        (first++)->~T();
+        releaseFront();
+    }
+    void clear(){
+        while(!empty()){
+            pop_back();
+        }
+    }
+
+    T& operator[](size_t index){
+        return first[index];
+    }
+    const T& operator[](size_t index) const {
+        return first[index];
+    }
+    T& at(size_t index){
+        if(index>=size()){
+            throw std::out_of_range("rewiring_deque::at");
+        }
+        return first[index];
+    }
+    const T& at(size_t index) const {
+        if(index>=size()){
+            throw std::out_of_range("rewiring_deque::at");
+        }
+        return first[index];
+    }
+    T& front(){
+        return *first;
+    }
+    const T& front() const {
+        return *first;
+    }
+    T& back(){
+        return *(last-1);
+    }
+    const T& back() const {
+        return *(last-1);
+    }
+
+    //the elements are contiguous, iterators are plain pointers
+    //they are invalidated when elements are inserted/removed at the front (one ring jump) and by emplace_front
+    iterator begin(){
+        return first;
+    }
+    iterator end(){
+        return last;
+    }
+    const_iterator begin() const {
+        return first;
+    }
+    const_iterator end() const {
+        return last;
+    }
+    const_iterator cbegin() const {
+        return first;
+    }
+    const_iterator cend() const {
+        return last;
+    }
+    reverse_iterator rbegin(){
+        return reverse_iterator(last);
+    }
+    reverse_iterator rend(){
+        return reverse_iterator(first);
+    }
+    const_reverse_iterator rbegin() const {
+        return const_reverse_iterator(last);
+    }
+    const_reverse_iterator rend() const {
+        return const_reverse_iterator(first);
+    }
+    T* data(){
+        return first;
+    }
+
+    size_t size() const {
+        return last-first;
+    }
+    bool empty() const {
+        return first==last;
+    }
+    //number of elements that fit into the ring without growing it
+    size_t capacity() const {
+        return ringPages*rewiring::page_size/sizeof(T)-1;
+    }
+
+    ~rewiring_deque(){
+        clear();
+        //free rewiring
+        delete r;
+    }
+};
@@ -0,0 +1,249 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include "rewiring.tcc"
+#include "page_pool.tcc"
+
+//page granular heap that carves all allocations from one large rewiring mapping
+//growing an allocation never copies data: the pages are either extended in place or rewired to a new location
+class rewiring_heap{
+    //rewiring "manager", owns the mapping
+    rewiring* r;
+    //source for page ids, recycles the page ids of freed allocations
+    page_pool pool;
+    //free virtual page ranges: start page -> number of pages
+    std::map<size_t,size_t> freeRanges;
+    //live allocations: start page -> number of pages
+    std::unordered_map<size_t,size_t> allocations;
+
+    Page* base() const {
+        return static_cast<Page*>(r->getMapping());
+    }
+    //throws std::bad_alloc for requests larger than the heap (also avoids the overflow of rounding up)
+    size_t pagesFor(size_t bytes) const {
+        if(bytes>getCapacity()*rewiring::page_size){
+            throw std::bad_alloc();
+        }
+        return (bytes+rewiring::page_size-1)/rewiring::page_size;
+    }
+    //reserves a free virtual page range (first fit)
+    size_t reserveRange(size_t pages){
+        for(auto it=freeRanges.begin();it!=freeRanges.end();++it){
+            if(it->second>=pages){
+                size_t start=it->first;
+                size_t remaining=it->second-pages;
+                freeRanges.erase(it);
+                if(remaining>0){
+                    freeRanges[start+pages]=remaining;
+                }
+                return start;
+            }
+        }
+        throw std::bad_alloc();
+    }
+    //tries to reserve the pages directly following an allocation
+    bool tryExtend(size_t start,size_t pages,size_t newPages){
+        auto it=freeRanges.find(start+pages);
+        size_t additional=newPages-pages;
+        if(it==freeRanges.end()||it->second<additional){
+            return false;
+        }
+        size_t remaining=it->second-additional;
+        freeRanges.erase(it);
+        if(remaining>0){
+            freeRanges[start+newPages]=remaining;
+        }
+        return true;
+    }
+    //returns a virtual page range and merges it with adjacent free ranges
+    void releaseRange(size_t start,size_t pages){
+        auto next=freeRanges.lower_bound(start);
+        if(next!=freeRanges.end()&&start+pages==next->first){
+            pages+=next->second;
+            next=freeRanges.erase(next);
+        }
+        if(next!=freeRanges.begin()){
+            auto prev=std::prev(next);
+            if(prev->first+prev->second==start){
+                prev->second+=pages;
+                return;
+            }
+        }
+        freeRanges[start]=pages;
+    }
+    //assigns page ids from the pool to a virtual page range and updates the mapping
+    void populate(size_t start,size_t pages){
+        pool.acquire(pages,&r->getPageIds()[start]);
+        r->syncToPT(start,pages);
+    }
+    size_t pageOf(void* ptr) const {
+        return static_cast<Page*>(ptr)-base();
+    }
+    //live allocation starting at ptr
+    std::unordered_map<size_t,size_t>::iterator findAllocation(void* ptr){
+        auto it=allocations.find(pageOf(ptr));
+        if(it==allocations.end()){
+            throw std::invalid_argument("rewiring_heap: pointer was not allocated by this heap or already freed");
+        }
+        return it;
+    }
+    //returns the page ids of a virtual page range to the pool and unmaps the range
+    //-> accesses after free see unassigned pages instead of the next allocation using the page ids
+    void unpopulate(size_t start,size_t pages){
+        PageId* pageIds=r->getPageIds();
+        pool.release(pages,&pageIds[start]);
+        std::fill(&pageIds[start],&pageIds[start+pages],PAGEID_UNASSIGNED);
+        r->syncToPT(start,pages);
+    }
+
+public:
+    //default capacity of the heap used by rewiring_allocator (16 GiB of virtual memory)
+    static constexpr size_t default_capacity=1ull<<22;
+
+    explicit rewiring_heap(size_t capacity=default_capacity,bool use_lkm=true)
+            :r(rewiring::create(use_lkm)),pool(r){
+        //reserve the whole virtual range up front, so that pointers stay valid
+        r->resize(capacity);
+        freeRanges[0]=capacity;
+    }
+    rewiring_heap(const rewiring_heap&)=delete;
+    rewiring_heap& operator=(const rewiring_heap&)=delete;
+
+    void* allocate(size_t bytes){
+        if(bytes==0){
+            return nullptr;
+        }
+        size_t pages=pagesFor(bytes);
+        size_t start=reserveRange(pages);
+        populate(start,pages);
+        allocations[start]=pages;
+        return &base()[start];
+    }
+
+    void deallocate(void* ptr){
+        if(ptr==nullptr){
+            return;
+        }
+        auto it=findAllocation(ptr);
+        size_t start=it->first;
+        size_t pages=it->second;
+        allocations.erase(it);
+        //the page ids are reused by later allocations
+        unpopulate(start,pages);
+        releaseRange(start,pages);
+    }
+
+    //realloc-style resizing: pages are never copied, only rewired
+    void* reallocate(void* ptr,size_t bytes){
+        if(ptr==nullptr){
+            return allocate(bytes);
+        }
+        if(bytes==0){
+            deallocate(ptr);
+            return nullptr;
+        }
+        auto it=findAllocation(ptr);
+        size_t start=it->first;
+        size_t pages=it->second;
+        size_t newPages=pagesFor(bytes);
+        if(newPages<=pages){
+            //shrink in place: return the tail pages
+            if(newPages<pages){
+                unpopulate(start+newPages,pages-newPages);
+                releaseRange(start+newPages,pages-newPages);
+                it->second=newPages;
+            }
+            return ptr;
+        }
+        if(tryExtend(start,pages,newPages)){
+            //grow in place: only the additional pages have to be mapped
+            populate(start+pages,newPages-pages);
+            it->second=newPages;
+            return ptr;
+        }
+        //grow by rewiring the existing pages to a larger free range
+        size_t newStart=reserveRange(newPages);
+        PageId* pageIds=r->getPageIds();
+        std::memcpy(&pageIds[newStart],&pageIds[start],pages*sizeof(PageId));
+        pool.acquire(newPages-pages,&pageIds[newStart+pages]);
+        r->syncToPT(newStart,newPages);
+        //the old range is free again, its page ids now belong to the new range
+        std::fill(&pageIds[start],&pageIds[start+pages],PAGEID_UNASSIGNED);
+        r->syncToPT(start,pages);
+        allocations.erase(it);
+        releaseRange(start,pages);
+        allocations[newStart]=newPages;
+        return &base()[newStart];
+    }
+
+    size_t getCapacity() const {
+        return r->getNumPages();
+    }
+
+    ~rewiring_heap(){
+        //free rewiring
+        delete r;
+    }
+
+    //heap shared by all default constructed rewiring_allocators
+    static rewiring_heap& instance(){
+        static rewiring_heap heap;
+        return heap;
+    }
+};
+
+//STL allocator: large buffers are taken from a rewiring_heap, small ones from malloc
+template<typename T>
+class rewiring_allocator{
+    template<typename U> friend class rewiring_allocator;
+    rewiring_heap* heap;
+public:
+    using value_type=T;
+    //buffers of at least this size are placed in the rewiring_heap
+    static constexpr size_t min_heap_bytes=16*rewiring::page_size;
+    static_assert(alignof(T)<=alignof(std::max_align_t),"over-aligned types are not supported");
+
+    rewiring_allocator() noexcept:heap(&rewiring_heap::instance()){}
+    explicit rewiring_allocator(rewiring_heap& heap) noexcept:heap(&heap){}
+    template<typename U>
+    rewiring_allocator(const rewiring_allocator<U>& other) noexcept:heap(other.heap){}
+
+    static constexpr size_t max_size() noexcept {
+        return std::numeric_limits<size_t>::max()/sizeof(T);
+    }
+    T* allocate(size_t n){
+        if(n>max_size()){
+            throw std::bad_array_new_length();
+        }
+        size_t bytes=n*sizeof(T);
+        void* res=bytes>=min_heap_bytes?heap->allocate(bytes):std::malloc(bytes);
+        if(res==nullptr&&bytes>0){
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(res);
+    }
+    void deallocate(T* ptr,size_t n){
+        if(n*sizeof(T)>=min_heap_bytes){
+            heap->deallocate(ptr);
+        }else{
+            std::free(ptr);
+        }
+    }
+
+    template<typename U>
+    bool operator==(const rewiring_allocator<U>& other) const {
+        return heap==other.heap;
+    }
+    template<typename U>
+    bool operator!=(const rewiring_allocator<U>& other) const {
+        return heap!=other.heap;
+    }
+};
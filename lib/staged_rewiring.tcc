@@ -37,7 +37,17 @@ public:
         return r->getNumPages();
     }
 
+    size_t staged_pages() const {
+        //number of pages of all staged rewirings
+        size_t pages=0;
+        for(const staging& st:staged){
+            pages+=st.len;
+        }
+        return pages;
+    }
+
     void stage_rewiring(Page *addr, Page *source, size_t n_pages) {
+        REWIRING_STATS_SCOPE(STAGE_REWIRING,n_pages);
         staging st{
             .start=static_cast<size_t>(addr-(Page*)getMapping()),
                 .len=n_pages,
@@ -53,6 +63,7 @@ public:
      * commit all staged rewirings
      */
     void commit_rewirings(){
+        REWIRING_STATS_SCOPE(COMMIT_REWIRINGS,staged_pages());
         //apply every staged rewiring
         for(staging st:staged){
             //do rewiring
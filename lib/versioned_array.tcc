@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "rewiring.tcc"
+#include "page_pool.tcc"
+
+//multi-version array (MVCC): every version is a view over the page pool of one rewiring object
+//a new version shares all unchanged pages with its predecessor, changed pages are copied to fresh page ids
+//that are mapped into the new version only -> old versions stay readable as plain arrays (no indirection)
+//pages that are no longer used by any version are recycled when versions are released
+template<typename T>
+class versioned_array{
+    static_assert(std::is_trivially_copyable<T>::value,"elements are copied page-wise");
+    //elements are laid out contiguously, an element may straddle two pages
+    static size_t firstPage(size_t index){
+        return index*sizeof(T)/rewiring::page_size;
+    }
+    static size_t lastPage(size_t index){
+        return ((index+1)*sizeof(T)-1)/rewiring::page_size;
+    }
+
+    //rewiring "manager", owns the page pool, the main mapping is used for filling new pages
+    rewiring* r;
+    //source for page ids, recycles the pages of released versions
+    page_pool pool;
+    //number of elements and pages of every version
+    size_t numElements;
+    size_t numPages;
+    //live versions: version number -> view
+    std::map<size_t,rewiring_view*> versions;
+    //number of versions using a page id
+    std::vector<uint32_t> refCounts;
+
+    void addReferences(const PageId* ids){
+        for(size_t i=0;i<numPages;i++){
+            if(ids[i]>=refCounts.size()){
+                refCounts.resize(std::max<size_t>(ids[i]+1,2*refCounts.size()),0);
+            }
+            refCounts[ids[i]]++;
+        }
+    }
+    rewiring_view* getView(size_t version) const {
+        auto it=versions.find(version);
+        if(it==versions.end()){
+            throw std::out_of_range("versioned_array: unknown or released version");
+        }
+        return it->second;
+    }
+
+public:
+    explicit versioned_array(size_t elements,bool use_lkm=true)
+            :r(rewiring::create(use_lkm)),pool(r),numElements(elements),
+             numPages((elements*sizeof(T)+rewiring::page_size-1)/rewiring::page_size){
+        //version 0: fresh pages
+        std::vector<PageId> ids(numPages);
+        pool.acquire(numPages,ids.data());
+        addReferences(ids.data());
+        versions[0]=r->createView(ids.data(),numPages);
+    }
+    versioned_array(const versioned_array&)=delete;
+    versioned_array& operator=(const versioned_array&)=delete;
+
+    size_t size() const {
+        return numElements;
+    }
+    size_t latestVersion() const {
+        return versions.rbegin()->first;
+    }
+    size_t getNumVersions() const {
+        return versions.size();
+    }
+    //elements of a version, valid until the version is released
+    const T* read(size_t version) const {
+        return static_cast<const T*>(getView(version)->getMapping());
+    }
+
+    //creates a new version from the latest one with the given writes (index, value) and returns its number
+    size_t commit(const std::vector<std::pair<size_t,T>>& writes){
+        rewiring_view* latest=versions.rbegin()->second;
+        //1. pages changed by the writes
+        std::vector<size_t> dirty;
+        dirty.reserve(writes.size());
+        for(auto& w:writes){
+            if(w.first>=numElements){
+                throw std::out_of_range("versioned_array: index out of range");
+            }
+            for(size_t page=firstPage(w.first);page<=lastPage(w.first);page++){
+                dirty.push_back(page);
+            }
+        }
+        std::sort(dirty.begin(),dirty.end());
+        dirty.erase(std::unique(dirty.begin(),dirty.end()),dirty.end());
+        //2. map fresh pages into the main mapping and copy the old contents
+        if(r->getNumPages()<dirty.size()){
+            r->resize(dirty.size());
+        }
+        auto* scratch=static_cast<Page*>(r->getMapping());
+        if(!dirty.empty()){
+            pool.acquire(dirty.size(),r->getPageIds());
+            r->syncToPT(0,dirty.size());
+            const auto* old=static_cast<const Page*>(latest->getMapping());
+            for(size_t i=0;i<dirty.size();i++){
+                scratch[i]=old[dirty[i]];
+            }
+        }
+        //3. apply the writes to the copies
+        //both pages of a straddling element are dirty -> their copies are adjacent in the main mapping
+        for(auto& w:writes){
+            size_t offset=w.first*sizeof(T);
+            size_t page=offset/rewiring::page_size;
+            size_t slot=std::lower_bound(dirty.begin(),dirty.end(),page)-dirty.begin();
+            std::memcpy(reinterpret_cast<char*>(&scratch[slot])+offset%rewiring::page_size,&w.second,sizeof(T));
+        }
+        //4. the new version maps the unchanged pages of the latest version and the copies
+        std::vector<PageId> ids(latest->getPageIds(),latest->getPageIds()+numPages);
+        for(size_t i=0;i<dirty.size();i++){
+            ids[dirty[i]]=r->getPageIds()[i];
+        }
+        addReferences(ids.data());
+        size_t version=latestVersion()+1;
+        versions[version]=r->createView(ids.data(),numPages);
+        return version;
+    }
+
+    //releases a version (garbage collection), pages that are not used by other versions are recycled
+    //the latest version can not be released
+    void release(size_t version){
+        if(version==latestVersion()){
+            throw std::invalid_argument("versioned_array: the latest version can not be released");
+        }
+        rewiring_view* view=getView(version);
+        const PageId* ids=view->getPageIds();
+        std::vector<PageId> unused;
+        for(size_t i=0;i<numPages;i++){
+            if(--refCounts[ids[i]]==0){
+                unused.push_back(ids[i]);
+            }
+        }
+        pool.release(unused.size(),unused.data());
+        versions.erase(version);
+        delete view;
+    }
+
+    ~versioned_array(){
+        //views have to be deleted before the rewiring object
+        for(auto& v:versions){
+            delete v.second;
+        }
+        delete r;
+    }
+};
@@ -5,7 +5,7 @@
 
 // header file that defines shared types for both, C++ libraries and kernel module
 //commands
-enum cmd_types{ GET_PAGE_IDS,SET_PAGE_IDS,CREATE_PAGE_IDS};
+enum cmd_types{ GET_PAGE_IDS,SET_PAGE_IDS,CREATE_PAGE_IDS,SET_PAGE_IDS_ENCODED,DEDUP_PAGES,CONFIGURE_RECLAIM,EVICT_PAGES,WRITE_PAGES};
 
 //two special page ids
 #define PAGEID_UNASSIGNED 0xffffffffu
@@ -19,6 +19,31 @@ struct cmd {
     void* mapping_start;
     void* payload;
 };
+//run of page ids for SET_PAGE_IDS_ENCODED: count page ids first, first+stride, first+2*stride, ...
+//stride=1 describes consecutive pages, stride=0 repeats the same page (or PAGEID_UNASSIGNED)
+//for SET_PAGE_IDS_ENCODED, payload points to an array of runs and len is the number of runs
+struct page_id_run {
+    unsigned int first;
+    int stride;
+    unsigned long count;
+};
+//DEDUP_PAGES merges pages with identical content and stores the number of freed pages (unsigned long) in payload
+//afterwards, page ids fetched before may be invalid and have to be fetched again
+//CONFIGURE_RECLAIM makes pages reclaimable: start is the file descriptor of a backing file (opened read/write, e.g. a file
+//on zram), len the maximal number of resident pages (0: no limit). page id p is evicted to offset p*page size
+//the backing file can only be replaced while no page is evicted (-EBUSY), passing the same file again changes the limit
+//EVICT_PAGES evicts len pages and stores the number of evicted pages (unsigned long) in payload
+//evicted pages keep their page ids, the next access reads them back
+//WRITE_PAGES allocates len new pages, fills them with data and stores their page ids in ids
+//the data is copied from buffer, or read from the file descriptor fd starting at offset, if buffer is NULL
+//(reads behind the end of the file yield zeros). payload points to a struct write_pages_args
+//on error, no page ids are stored and no pages are created
+struct write_pages_args {
+    const void* buffer;
+    int fd;
+    unsigned long offset;
+    unsigned int* ids;
+};
 //assemble a 'valid' ioctl command for communication
 #define REW_CMD _IOC(IOC_INOUT,'k',0u,1u)
 
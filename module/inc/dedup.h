@@ -0,0 +1,21 @@
+#ifndef REWIRING_DEDUP_H
+#define REWIRING_DEDUP_H
+
+#include <linux/mm_types.h>
+#include "global_state.h"
+
+/**
+ * merges physical pages with identical content into one page id
+ * all mappings of the file are rewritten to the remaining page, which becomes
+ * copy-on-write: it is mapped read-only and the first write copies it again
+ * mappings of address spaces that are busy (mmap lock taken) are left alone, their pages are not merged
+ * the page table entries of all other pages are removed before their content is compared,
+ * so that no write happens meanwhile. the next access faults them in again
+ * the global lock has to be held
+ * @param state the global state whose pages are deduplicated
+ * @param mm the address space whose mmap lock the caller holds (or NULL)
+ * @return the number of freed pages or a negative error code
+ */
+long dedup_pages(struct global_state *state, struct mm_struct *mm);
+
+#endif //REWIRING_DEDUP_H
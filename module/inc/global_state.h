@@ -1,6 +1,9 @@
 #ifndef REWIRING_GLOBAL_STATE_H
 #define REWIRING_GLOBAL_STATE_H
 #include <linux/mutex.h>
+#include <linux/list.h>
+#include <linux/fs.h>
+#include <linux/gfp.h>
 typedef unsigned PageId;
 
 /**
@@ -19,6 +22,19 @@ struct page_info {
      * kernel address
      */
 	unsigned long kaddr;
+	/**
+     * page is shared by deduplication: mapped read-only, the first write copies it
+     */
+	int cow;
+	/**
+     * content of the page was evicted to the backing file (valid is false meanwhile)
+     * valid and swapped: the page is being written to the backing file by an eviction
+     */
+	int swapped;
+	/**
+     * page was accessed since the last eviction pass
+     */
+	int referenced;
 };
 struct global_state {
 	//number of physical pages
@@ -27,11 +43,40 @@ struct global_state {
 	unsigned long page_info_size;
 	//array of "physical pages"
 	struct page_info *pageInfos;
+	//all mappings (local states) of this file
+	struct list_head mappings;
+	//number of pages currently held in memory
+	unsigned long resident_count;
+	//reclaim: backing file for evicted pages, NULL if pages are not reclaimable
+	struct file *backing;
+	//reclaim: pages are evicted when more pages are resident (0: no limit)
+	unsigned long resident_limit;
+	//reclaim: next page id inspected by the eviction clock
+	PageId clock_hand;
+	//reclaim: an eviction is writing its victims (without holding the lock)
+	int evicting;
+	//reclaim: evicts pages under memory pressure, NULL if not registered
+	struct shrinker *shrinker;
+	//flags for allocating pages (memcg accounted if reclaimable)
+	gfp_t gfp;
 	//lock per file
 	struct mutex lock;
 };
 
-void free_page_info(struct page_info *info);
+/**
+ * returns the physical page of a page info to the kernel
+ * @param state the state the page belongs to
+ * @param info the page info
+ */
+void free_page_info(struct global_state *state, struct page_info *info);
+
+/**
+ * assigns a new page id to a page that was allocated by the caller
+ * @param state the state that takes ownership of the page
+ * @param kaddr kernel address of the page (order 0, allocated with state->gfp)
+ * @return the page id or PAGEID_UNASSIGNED, if the page info array could not be enlarged
+ */
+PageId add_page(struct global_state *state, unsigned long kaddr);
 
 /**
  * allocates a new page and returns a pageId
@@ -56,6 +101,7 @@ void dec_usage(struct global_state *state, PageId pageId);
 
 /**
  * retrieves the kernel address for a page id
+ * a page that is being evicted stays resident, as the caller is about to map it
  * @param state the state that stores all page information
  * @param pageId the page id for which the kernel address should be returned
  * @param kaddr a pointer to a unsigned long for storing the resulting kernel address
@@ -64,6 +110,32 @@ void dec_usage(struct global_state *state, PageId pageId);
 int kaddr_by_pageId(struct global_state *state, PageId pageId,
 		    unsigned long *kaddr);
 
+/**
+ * checks that a page id refers to an existing page (resident or evicted)
+ * page ids of pages freed by deduplication (or never created) are invalid
+ * @param state the state that stores all page information
+ * @param pageId the page id
+ * @return 1 if the page id may be mapped, 0 otherwise
+ */
+int valid_page_id(struct global_state *state, PageId pageId);
+
+/**
+ * checks if a page is shared by deduplication and has to be mapped read-only
+ * @param state the state that stores all page information
+ * @param pageId the page id
+ * @return 1 if the page is copy-on-write, 0 otherwise
+ */
+int is_cow_page(struct global_state *state, PageId pageId);
+
+/**
+ * brings an evicted page back from the backing file
+ * the eviction of a page that is still being written is cancelled instead
+ * @param state the state that stores all page information
+ * @param pageId the page id
+ * @return 0 if the page is resident (now), -ENOMEM if no page could be allocated, -EIO if it could not be read
+ */
+int swap_in_page(struct global_state *state, PageId pageId);
+
 /**
  * Initializes the given state
  * @param state pointer to be initialized
@@ -0,0 +1,21 @@
+#ifndef REWIRING_INGEST_H
+#define REWIRING_INGEST_H
+
+#include "communication.h"
+#include "global_state.h"
+
+/**
+ * allocates new pages, fills them with data from a user buffer or a file and
+ * returns their page ids (WRITE_PAGES)
+ * the pages are filled in the kernel, they are never faulted in user space
+ * the pages are filled without holding the global lock, it is only taken to register them
+ * the global lock must not be held
+ * @param state the global state the pages are added to
+ * @param args the source of the data and the destination of the page ids
+ * @param count the number of pages
+ * @return 0 if successful, a negative error code otherwise (no page ids are returned, all pages are freed again)
+ */
+long write_pages(struct global_state *state, struct write_pages_args *args,
+		 unsigned long count);
+
+#endif //REWIRING_INGEST_H
@@ -1,17 +1,43 @@
 #ifndef REWIRING_LOCAL_STATE_H
 #define REWIRING_LOCAL_STATE_H
 
+#include <linux/xarray.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/version.h>
 #include "global_state.h"
 
+//depending on the linux kernel version, the mmap lock has to be taken directly
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 8, 0)
+#define mmap_read_lock(mm) down_read(&(mm)->mmap_sem)
+#define mmap_read_trylock(mm) down_read_trylock(&(mm)->mmap_sem)
+#define mmap_read_unlock(mm) up_read(&(mm)->mmap_sem)
+#endif
+
+//number of page ids per chunk of the mapping (one kernel page)
+#define MAPPING_CHUNK_SIZE (PAGE_SIZE / sizeof(PageId))
+
 struct local_state {
 	//number of virtual pages
 	unsigned long vpages_count;
 
 	//mapping of virtual pages to physical pages via page ids
-	PageId *mapping;
+	//sparse: chunk index -> chunk of MAPPING_CHUNK_SIZE page ids
+	//chunks are allocated on the first assignment, missing chunks are unassigned
+	struct xarray chunks;
+
+	//last chunk used for a lookup, faults and updates are mostly sequential
+	unsigned long cached_index;
+	PageId *cached_chunk;
 
 	//link to global (per-file) state
 	struct global_state *global;
+	//the mapping this state belongs to
+	struct vm_area_struct *vma;
+	//entry in the list of mappings of the global state
+	struct list_head list;
+	//page table entries may be changed by the running deduplication/eviction (see lock_mapping_mm)
+	int pt_locked;
 };
 
 /**
@@ -22,12 +48,23 @@ void init_local_state(struct local_state *state);
 
 /**
  * releases all ressources associated with the state
+ * the usage counts of all assigned pages are decremented, the global lock has to be held
  * @param state the state to be released
  */
 void release_local_state(struct local_state *state);
 
+/**
+ * copies all page ids of another mapping, e.g. when the vma is copied by fork or mremap
+ * the usage counts of the pages are incremented, the global lock has to be held
+ * @param dest the new (initialized) state
+ * @param src the state whose page ids are copied
+ * @return 1 if successful, 0 if a chunk could not be allocated
+ */
+int copy_local_state(struct local_state *dest, struct local_state *src);
+
 /**
  * resizes the mapping of the state to a new length
+ * only chunks beyond the new length are freed, growing does not allocate anything
  * @param state the state
  * @param length the new length
  */
@@ -46,8 +83,38 @@ PageId get_page_id(struct local_state *state, unsigned long offset);
  * @param state  the state
  * @param offset  the offset inside the mapping area
  * @param pageId the page id to set
+ * @return 1 if successful, 0 if the offset is invalid or no chunk could be allocated
+ */
+int set_page_id(struct local_state *state, unsigned long offset,
+		PageId pageId);
+
+/**
+ * copies a range of page ids, e.g. to a kernel buffer that is copied to userspace later
+ * @param state the state
+ * @param start first offset inside the mapping area
+ * @param len number of page ids
+ * @param dest destination array
+ */
+void copy_page_ids(struct local_state *state, unsigned long start,
+		   unsigned long len, PageId *dest);
+
+/**
+ * locks the address space of a mapping for changing its page table entries from outside its page faults
+ * (deduplication, eviction). the global lock has to be held, it keeps the vma alive until dev_mmap_close
+ * removed the mapping. as the lock order is mmap lock -> global lock, the mmap lock is only tried
+ * a user reference to the address space is held until unlock_mapping_mm, exiting address spaces are skipped
+ * @param state the state of the mapping
+ * @param locked address space whose mmap lock the caller holds already (or NULL)
+ * @return 1 if the page table entries can be changed (unlock with unlock_mapping_mm), 0 if the address space is busy
+ */
+int lock_mapping_mm(struct local_state *state, struct mm_struct *locked);
+
+/**
+ * unlocks an address space locked by lock_mapping_mm, the user reference is dropped asynchronously
+ * (the global lock may be held)
+ * @param state the state of the mapping
+ * @param locked the address space passed to lock_mapping_mm
  */
-void set_page_id(struct local_state *state, unsigned long offset,
-		 PageId pageId);
+void unlock_mapping_mm(struct local_state *state, struct mm_struct *locked);
 
 #endif //REWIRING_LOCAL_STATE_H
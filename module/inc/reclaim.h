@@ -0,0 +1,73 @@
+#ifndef REWIRING_RECLAIM_H
+#define REWIRING_RECLAIM_H
+
+#include "global_state.h"
+
+/**
+ * evicts pages to the backing file of the state
+ * victims are chosen by a clock over all page ids: pages accessed since the last
+ * pass (accessed bit in the page table or fault) get a second chance,
+ * deduplicated pages are never evicted
+ * page table entries of evicted pages are removed, the next access faults them in again
+ * mappings whose address space is busy (mmap lock taken, see lock_mapping_mm) keep their pages
+ * the victims are written without holding the global lock, a page that is accessed or mapped
+ * meanwhile stays resident. only one eviction runs at a time
+ * the global lock must not be held
+ * @param state the global state whose pages are evicted
+ * @param count the number of pages to evict
+ * @param exclude a page id that stays resident (e.g. the page of the running fault) or PAGEID_UNASSIGNED
+ * @return the number of evicted pages (0 if another eviction is running) or a negative error code
+ */
+long evict_pages(struct global_state *state, unsigned long count,
+		 PageId exclude);
+
+/**
+ * checks (without locking) if more pages are resident than the limit allows
+ * @param state the global state
+ * @return 1 if pages have to be evicted, 0 otherwise
+ */
+int over_resident_limit(struct global_state *state);
+
+/**
+ * evicts a batch of pages, if more pages than allowed are resident
+ * called after new pages were allocated or brought back
+ * the global lock must not be held
+ * @param state the global state
+ * @param exclude a page id that stays resident or PAGEID_UNASSIGNED
+ */
+void reclaim_if_needed(struct global_state *state, PageId exclude);
+
+/**
+ * evicts a batch of pages after an allocation of state->gfp failed
+ * reclaimable pages are allocated without retrying (memory cgroup limit or memory pressure),
+ * the pages of the file are evicted instead of invoking the OOM killer
+ * the global lock must not be held
+ * @param state the global state
+ * @return 1 if memory was freed and the allocation should be retried, 0 otherwise
+ */
+int reclaim_for_allocation(struct global_state *state);
+
+/**
+ * checks if the backing file is needed: pages are evicted to it or an eviction is writing to it
+ * the global lock has to be held
+ * @param state the global state
+ * @return 1 if the backing file must not be replaced, 0 otherwise
+ */
+int backing_in_use(struct global_state *state);
+
+/**
+ * registers a shrinker that evicts pages of the state under global memory pressure
+ * the shrinker does not know about memory cgroups, a cgroup limit is handled by reclaim_for_allocation
+ * the global lock has to be held
+ * @param state the global state, reclaim has to be configured
+ * @return 0 if successful (or already registered), a negative error code otherwise
+ */
+int register_reclaim_shrinker(struct global_state *state);
+
+/**
+ * unregisters the shrinker of the state, waits for running scans
+ * @param state the global state
+ */
+void unregister_reclaim_shrinker(struct global_state *state);
+
+#endif //REWIRING_RECLAIM_H
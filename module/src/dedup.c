@@ -0,0 +1,209 @@
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/jhash.h>
+#include <linux/sort.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/bitops.h>
+
+#include "communication.h"
+#include "global_state.h"
+#include "local_state.h"
+#include "dedup.h"
+
+//content hash of a physical page
+struct page_hash {
+	u32 hash;
+	PageId pageId;
+};
+
+static int cmp_page_hash(const void *a, const void *b)
+{
+	//order by hash, then by page id -> the lowest page id of identical pages is kept
+	const struct page_hash *x = a;
+	const struct page_hash *y = b;
+	if (x->hash != y->hash)
+		return x->hash < y->hash ? -1 : 1;
+	if (x->pageId != y->pageId)
+		return x->pageId < y->pageId ? -1 : 1;
+	return 0;
+}
+
+static unsigned long find_duplicates(struct global_state *state,
+				     struct page_hash *hashes,
+				     unsigned long count, PageId *remap)
+{
+	//compares pages with equal hashes, remap stores the page id that is kept
+	unsigned long duplicates = 0;
+	for (unsigned long i = 0; i < count; i++) {
+		PageId keep = hashes[i].pageId;
+		if (remap[keep] != keep)
+			continue; //already merged into another page
+		void *keepAddr = (void *)state->pageInfos[keep].kaddr;
+		for (unsigned long j = i + 1;
+		     j < count && hashes[j].hash == hashes[i].hash; j++) {
+			PageId dup = hashes[j].pageId;
+			if (remap[dup] != dup)
+				continue;
+			if (memcmp(keepAddr, (void *)state->pageInfos[dup].kaddr,
+				   PAGE_SIZE) == 0) {
+				remap[dup] = keep;
+				state->pageInfos[keep].cow = true;
+				duplicates++;
+			}
+		}
+	}
+	return duplicates;
+}
+
+static void zap_run(struct local_state *local, unsigned long start,
+		    unsigned long len)
+{
+	//removes page table entries, the next access faults them in again (waiting for the global lock)
+	struct vm_area_struct *vma = local->vma;
+	if (len == 0)
+		return;
+	zap_vma_ptes(vma, vma->vm_start + start * 4096 - vma->vm_pgoff * 4096,
+		     len * 4096);
+}
+
+//pages that may be merged: resident, mapped and not used by a mapping that can not be locked
+//pages that are being evicted (valid and swapped) are left alone
+static int is_candidate(struct global_state *state, PageId pageId,
+			unsigned long *excluded)
+{
+	if (pageId >= state->ppages_count)
+		return false;
+	struct page_info *info = &state->pageInfos[pageId];
+	return info->valid && !info->swapped && info->usage_count > 0 &&
+	       !test_bit(pageId, excluded);
+}
+
+static void protect_mapping(struct local_state *local, unsigned long *excluded)
+{
+	//removes the page table entries of all candidates before their content is compared:
+	//a write meanwhile faults and waits for the global lock, so no store is lost or shared
+	//(zap_vma_ptes flushes the TLB and informs secondary MMUs)
+	struct global_state *state = local->global;
+	unsigned long runStart = 0;
+	unsigned long runLen = 0;
+	unsigned long index;
+	PageId *chunk;
+	xa_for_each (&local->chunks, index, chunk) {
+		for (unsigned long i = 0; i < MAPPING_CHUNK_SIZE; i++) {
+			unsigned long offset = index * MAPPING_CHUNK_SIZE + i;
+			if (!is_candidate(state, chunk[i], excluded))
+				continue;
+			//collect runs of candidates
+			if (runLen > 0 && runStart + runLen == offset) {
+				runLen++;
+			} else {
+				zap_run(local, runStart, runLen);
+				runStart = offset;
+				runLen = 1;
+			}
+		}
+	}
+	zap_run(local, runStart, runLen);
+}
+
+static void rewrite_mapping(struct local_state *local, PageId *remap)
+{
+	//replaces merged page ids, the page table entries were removed by protect_mapping
+	//the next access maps shared pages read-only
+	struct global_state *state = local->global;
+	unsigned long index;
+	PageId *chunk;
+	xa_for_each (&local->chunks, index, chunk) {
+		for (unsigned long i = 0; i < MAPPING_CHUNK_SIZE; i++) {
+			unsigned long offset = index * MAPPING_CHUNK_SIZE + i;
+			PageId pageId = chunk[i];
+			if (pageId >= state->ppages_count ||
+			    remap[pageId] == pageId)
+				continue;
+			set_page_id(local, offset, remap[pageId]);
+		}
+	}
+}
+
+//marks all pages of a mapping, they must neither be merged nor shared
+static void exclude_mapping(struct local_state *local, unsigned long *excluded)
+{
+	struct global_state *state = local->global;
+	unsigned long index;
+	PageId *chunk;
+	xa_for_each (&local->chunks, index, chunk) {
+		for (unsigned long i = 0; i < MAPPING_CHUNK_SIZE; i++) {
+			if (chunk[i] < state->ppages_count)
+				set_bit(chunk[i], excluded);
+		}
+	}
+}
+
+long dedup_pages(struct global_state *state, struct mm_struct *mm)
+{
+	unsigned long n = state->ppages_count;
+	if (n == 0)
+		return 0;
+	struct page_hash *hashes = vmalloc(n * sizeof(struct page_hash));
+	PageId *remap = vmalloc(n * sizeof(PageId));
+	unsigned long *excluded = vzalloc(BITS_TO_LONGS(n) * sizeof(long));
+	if (hashes == NULL || remap == NULL || excluded == NULL) {
+		vfree(hashes);
+		vfree(remap);
+		vfree(excluded);
+		return -ENOMEM;
+	}
+	//lock the address spaces of all mappings, whose page table entries have to be changed
+	//pages of mappings that can not be locked stay as they are
+	struct local_state *local;
+	list_for_each_entry (local, &state->mappings, list) {
+		local->pt_locked = lock_mapping_mm(local, mm);
+		if (!local->pt_locked)
+			exclude_mapping(local, excluded);
+	}
+	//all remaining candidates are mapped by locked mappings only -> make them inaccessible
+	list_for_each_entry (local, &state->mappings, list) {
+		if (local->pt_locked)
+			protect_mapping(local, excluded);
+	}
+	//hash all candidates, their content can not change until the global lock is released
+	//unmapped pages are left alone, their page ids may still be in use by userspace
+	unsigned long count = 0;
+	for (PageId i = 0; i < n; i++) {
+		remap[i] = i;
+		if (!is_candidate(state, i, excluded))
+			continue;
+		hashes[count].hash = jhash2((u32 *)state->pageInfos[i].kaddr,
+					    PAGE_SIZE / sizeof(u32), 0);
+		hashes[count].pageId = i;
+		count++;
+		cond_resched();
+	}
+	sort(hashes, count, sizeof(struct page_hash), cmp_page_hash, NULL);
+	long freed = 0;
+	if (find_duplicates(state, hashes, count, remap) > 0) {
+		//let every mapping use the remaining pages
+		//(mappings that are not locked do not use any of the affected pages)
+		list_for_each_entry (local, &state->mappings, list) {
+			if (local->pt_locked)
+				rewrite_mapping(local, remap);
+		}
+		//return merged pages to the kernel
+		for (PageId i = 0; i < n; i++) {
+			if (remap[i] != i && state->pageInfos[i].usage_count == 0) {
+				free_page_info(state, &state->pageInfos[i]);
+				freed++;
+			}
+		}
+	}
+	list_for_each_entry (local, &state->mappings, list) {
+		if (local->pt_locked)
+			unlock_mapping_mm(local, mm);
+		local->pt_locked = false;
+	}
+	vfree(hashes);
+	vfree(remap);
+	vfree(excluded);
+	return freed;
+}
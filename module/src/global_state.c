@@ -4,6 +4,7 @@
 #include <linux/vmalloc.h>
 #include "global_state.h"
 #include "communication.h"
+#include "reclaim.h"
 
 void init_global_state(struct global_state *state)
 {
@@ -11,18 +12,32 @@ void init_global_state(struct global_state *state)
 	state->pageInfos = NULL;
 	state->page_info_size = 0;
 	state->ppages_count = 0;
+	INIT_LIST_HEAD(&state->mappings);
+	state->resident_count = 0;
+	state->backing = NULL;
+	state->resident_limit = 0;
+	state->clock_hand = 0;
+	state->evicting = false;
+	state->shrinker = NULL;
+	state->gfp = GFP_KERNEL;
 	//init lock
 	mutex_init(&state->lock);
 }
 
 void release_global_state(struct global_state *state)
 {
+	//no eviction may run while the pages are freed
+	unregister_reclaim_shrinker(state);
 	//free physical pages
 	for (size_t i = 0; i < state->ppages_count; i++) {
-		free_page_info(&state->pageInfos[i]);
+		free_page_info(state, &state->pageInfos[i]);
 	}
 	//free arrays
 	vfree(state->pageInfos);
+	//close backing file
+	if (state->backing != NULL) {
+		fput(state->backing);
+	}
 	//destroy lock
 	mutex_destroy(&state->lock);
 }
@@ -50,15 +65,17 @@ int resize_page_info_arr(struct global_state *state)
 	state->pageInfos = newArr;
 	return true;
 }
-void free_page_info(struct page_info *info)
+void free_page_info(struct global_state *state, struct page_info *info)
 {
 	if (info->valid) {
 		//return page to kernel
 		free_page(info->kaddr);
+		info->valid = false;
+		state->resident_count--;
 	}
 }
 
-PageId alloc_new_page(struct global_state *state)
+PageId add_page(struct global_state *state, unsigned long kaddr)
 {
 	if (state->ppages_count == state->page_info_size) {
 		//we need to enlarge the array of page infos first
@@ -68,12 +85,26 @@ PageId alloc_new_page(struct global_state *state)
 	}
 	//"allocate" new page id
 	PageId pageId = state->ppages_count++;
+	state->pageInfos[pageId].kaddr = kaddr;
+	state->pageInfos[pageId].valid = true;
+	state->pageInfos[pageId].cow = false;
+	state->pageInfos[pageId].swapped = false;
+	state->pageInfos[pageId].referenced = true;
+	state->resident_count++;
+	return pageId;
+}
+
+PageId alloc_new_page(struct global_state *state)
+{
 	//get fresh page from kernel
-	state->pageInfos[pageId].kaddr = get_zeroed_page(GFP_KERNEL);
-	if(state->pageInfos[pageId].kaddr==0){
-	    return PAGEID_UNASSIGNED;
+	unsigned long kaddr = get_zeroed_page(state->gfp);
+	if (kaddr == 0) {
+		return PAGEID_UNASSIGNED;
+	}
+	PageId pageId = add_page(state, kaddr);
+	if (pageId == PAGEID_UNASSIGNED) {
+		free_page(kaddr);
 	}
-	state->pageInfos[pageId].valid = true;
 	return pageId;
 }
 
@@ -104,10 +135,62 @@ int kaddr_by_pageId(struct global_state *state, PageId pageId,
 	struct page_info *pageInfo = &state->pageInfos[pageId];
 	//check if page info is valid
 	if (pageInfo->valid) {
+		//the page is used again -> cancel a running eviction
+		pageInfo->swapped = false;
 		//return kaddr
 		*kaddr = pageInfo->kaddr;
 		return true;
 	}
 	//page info is not valid -> return false
 	return false;
-}
\ No newline at end of file
+}
+int valid_page_id(struct global_state *state, PageId pageId)
+{
+	if (pageId >= state->ppages_count) {
+		return false;
+	}
+	return state->pageInfos[pageId].valid ||
+	       state->pageInfos[pageId].swapped;
+}
+int is_cow_page(struct global_state *state, PageId pageId)
+{
+	if (pageId >= state->ppages_count) {
+		return false;
+	}
+	return state->pageInfos[pageId].cow;
+}
+
+int swap_in_page(struct global_state *state, PageId pageId)
+{
+	if (pageId >= state->ppages_count) {
+		return -EINVAL;
+	}
+	struct page_info *info = &state->pageInfos[pageId];
+	if (info->valid) {
+		//resident or still being written by an eviction -> cancel the eviction
+		info->swapped = false;
+		return 0;
+	}
+	if (!info->swapped) {
+		return -EINVAL;
+	}
+	//get fresh page and read content from backing file
+	unsigned long kaddr = __get_free_page(state->gfp);
+	if (kaddr == 0) {
+		return -ENOMEM;
+	}
+	loff_t pos = (loff_t)pageId * PAGE_SIZE;
+	if (kernel_read(state->backing, (void *)kaddr, PAGE_SIZE, &pos) !=
+	    PAGE_SIZE) {
+		printk(KERN_WARNING "REWIRING_LKM: could not read page %u\n",
+		       pageId);
+		free_page(kaddr);
+		return -EIO;
+	}
+	info->kaddr = kaddr;
+	info->valid = true;
+	info->swapped = false;
+	info->referenced = true;
+	state->resident_count++;
+	return 0;
+}
@@ -0,0 +1,165 @@
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/highmem.h>
+#include <linux/uaccess.h>
+#include <linux/overflow.h>
+#include <linux/vmalloc.h>
+#include <linux/version.h>
+
+#include "communication.h"
+#include "global_state.h"
+#include "reclaim.h"
+#include "ingest.h"
+
+//number of pages allocated, filled and registered at once
+#define INGEST_BATCH 64
+
+static unsigned long alloc_batch(gfp_t gfp, unsigned long count,
+				 struct page **pages)
+{
+	//the pages are overwritten completely -> no need for zeroed pages
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+	return alloc_pages_bulk(gfp, count, pages);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+	return alloc_pages_bulk_array(gfp, count, pages);
+#else
+	unsigned long allocated;
+	for (allocated = 0; allocated < count; allocated++) {
+		pages[allocated] = alloc_page(gfp);
+		if (pages[allocated] == NULL)
+			break;
+	}
+	return allocated;
+#endif
+}
+
+static long fill_batch(struct write_pages_args *args, struct file *source,
+		       unsigned long done, unsigned long count,
+		       struct page **pages)
+{
+	//map the batch contiguously, so that it is filled by one copy/read
+	void *dest = vmap(pages, count, VM_MAP, PAGE_KERNEL);
+	if (dest == NULL)
+		return -ENOMEM;
+	unsigned long bytes = count * PAGE_SIZE;
+	long res = 0;
+	if (source == NULL) {
+		if (copy_from_user(dest, (char *)args->buffer + done * PAGE_SIZE,
+				   bytes))
+			res = -EFAULT;
+	} else {
+		loff_t pos = args->offset + done * PAGE_SIZE;
+		unsigned long filled = 0;
+		while (filled < bytes) {
+			ssize_t read = kernel_read(source, (char *)dest + filled,
+						   bytes - filled, &pos);
+			if (read < 0) {
+				res = read;
+				break;
+			}
+			if (read == 0) {
+				//end of file: the remaining pages are zero
+				memset((char *)dest + filled, 0, bytes - filled);
+				break;
+			}
+			filled += read;
+		}
+	}
+	vunmap(dest);
+	return res;
+}
+
+static void free_batch(struct page **pages, unsigned long from,
+		       unsigned long to)
+{
+	for (unsigned long i = from; i < to; i++)
+		__free_page(pages[i]);
+}
+
+static unsigned long register_batch(struct global_state *state,
+				    unsigned long count, struct page **pages,
+				    PageId *ids)
+{
+	//assigns page ids to the filled pages, frees the pages that got none
+	mutex_lock(&state->lock);
+	unsigned long registered;
+	for (registered = 0; registered < count; registered++) {
+		unsigned long kaddr =
+			(unsigned long)page_address(pages[registered]);
+		ids[registered] = add_page(state, kaddr);
+		if (ids[registered] == PAGEID_UNASSIGNED)
+			break;
+	}
+	mutex_unlock(&state->lock);
+	free_batch(pages, registered, count);
+	return registered;
+}
+
+static void release_ids(struct global_state *state, PageId *ids,
+			unsigned long count)
+{
+	//the page ids never reached user space -> free their pages again
+	mutex_lock(&state->lock);
+	for (unsigned long i = 0; i < count; i++)
+		free_page_info(state, &state->pageInfos[ids[i]]);
+	mutex_unlock(&state->lock);
+}
+
+long write_pages(struct global_state *state, struct write_pages_args *args,
+		 unsigned long count)
+{
+	struct page *pages[INGEST_BATCH];
+	PageId *ids = kvmalloc_array(max(count, 1UL), sizeof(PageId), GFP_KERNEL);
+	if (ids == NULL)
+		return -ENOMEM;
+	struct file *source = NULL;
+	if (args->buffer == NULL) {
+		source = fget(args->fd);
+		if (source == NULL) {
+			kvfree(ids);
+			return -EBADF;
+		}
+	}
+	long res = 0;
+	unsigned long done = 0;
+	while (done < count && res == 0) {
+		unsigned long batch = min_t(unsigned long, count - done,
+					    INGEST_BATCH);
+		//keep the resident limit, eviction takes the global lock itself
+		reclaim_if_needed(state, PAGEID_UNASSIGNED);
+		memset(pages, 0, sizeof(pages));
+		unsigned long allocated =
+			alloc_batch(READ_ONCE(state->gfp), batch, pages);
+		if (allocated < batch) {
+			free_batch(pages, 0, allocated);
+			//evict pages of the file and try again
+			if (!reclaim_for_allocation(state))
+				res = -ENOMEM;
+			continue;
+		}
+		//the pages are filled without any lock, the buffer may be a rewired mapping itself
+		res = fill_batch(args, source, done, batch, pages);
+		if (res < 0) {
+			free_batch(pages, 0, batch);
+			break;
+		}
+		unsigned long registered =
+			register_batch(state, batch, pages, &ids[done]);
+		done += registered;
+		if (registered < batch)
+			res = -ENOMEM;
+		cond_resched();
+	}
+	if (source != NULL)
+		fput(source);
+	if (res == 0 &&
+	    copy_to_user(args->ids, ids, array_size(count, sizeof(PageId))))
+		res = -EFAULT;
+	if (res < 0)
+		release_ids(state, ids, done);
+	kvfree(ids);
+	return res;
+}
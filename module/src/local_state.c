@@ -2,43 +2,110 @@
 #include <linux/gfp.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
+#include <linux/sched/mm.h>
 
 #include "communication.h"
 #include "local_state.h"
 
+//chunk full of unassigned page ids, used for copying missing chunks
+static const PageId unassigned_chunk[MAPPING_CHUNK_SIZE] = {
+	[0 ... MAPPING_CHUNK_SIZE - 1] = PAGEID_UNASSIGNED
+};
+
 void init_local_state(struct local_state *state)
 {
 	//initialize values with zero
-	state->mapping = NULL;
+	xa_init(&state->chunks);
+	state->cached_index = 0;
+	state->cached_chunk = NULL;
 	state->vpages_count = 0;
+	state->vma = NULL;
+	INIT_LIST_HEAD(&state->list);
+	state->pt_locked = false;
 }
 
 void release_local_state(struct local_state *state)
 {
-	//free mapping array
-	vfree(state->mapping);
+	//the pages are no longer used by this mapping, then free all chunks of the mapping
+	unsigned long index;
+	PageId *chunk;
+	xa_for_each (&state->chunks, index, chunk) {
+		for (unsigned long i = 0; i < MAPPING_CHUNK_SIZE; i++) {
+			if (chunk[i] != PAGEID_UNASSIGNED)
+				dec_usage(state->global, chunk[i]);
+		}
+		free_page((unsigned long)chunk);
+	}
+	xa_destroy(&state->chunks);
+	state->cached_chunk = NULL;
+}
+
+int copy_local_state(struct local_state *dest, struct local_state *src)
+{
+	unsigned long index;
+	PageId *chunk;
+	dest->vpages_count = src->vpages_count;
+	xa_for_each (&src->chunks, index, chunk) {
+		PageId *copy = (PageId *)__get_free_page(GFP_KERNEL);
+		if (copy == NULL)
+			return false;
+		memcpy(copy, chunk, PAGE_SIZE);
+		if (xa_err(xa_store(&dest->chunks, index, copy, GFP_KERNEL))) {
+			free_page((unsigned long)copy);
+			return false;
+		}
+		//the copy uses the same pages
+		for (unsigned long i = 0; i < MAPPING_CHUNK_SIZE; i++) {
+			if (copy[i] != PAGEID_UNASSIGNED)
+				inc_usage(dest->global, copy[i]);
+		}
+	}
+	return true;
+}
+
+static PageId *lookup_chunk(struct local_state *state, unsigned long index)
+{
+	//returns the chunk for a chunk index or NULL, if it is not allocated
+	if (state->cached_chunk != NULL && state->cached_index == index) {
+		return state->cached_chunk;
+	}
+	PageId *chunk = xa_load(&state->chunks, index);
+	if (chunk != NULL) {
+		state->cached_index = index;
+		state->cached_chunk = chunk;
+	}
+	return chunk;
 }
 
 int resize_mapping(struct local_state *state, unsigned long length)
 {
-	if (length == state->vpages_count)
+	if (length >= state->vpages_count) {
+		//growing: new page ids are unassigned, chunks are allocated lazily
+		state->vpages_count = length;
 		return true;
-	//allocate larger array for page ids
-	PageId *newPageIds = vmalloc(sizeof(PageId) * length);
-	if(newPageIds==NULL){
-	    return false;
 	}
-	//migrate page ids to new array
-	memcpy(newPageIds, state->mapping,
-	       sizeof(PageId) * min(state->vpages_count, length));
-	//set all other page ids to unassigned
-	if (length > state->vpages_count) {
-		memset(&newPageIds[state->vpages_count], 0xff,
-		       (length - state->vpages_count) * sizeof(PageId));
+	//shrinking: free all chunks behind the new end
+	unsigned long firstFree = (length + MAPPING_CHUNK_SIZE - 1) /
+				  MAPPING_CHUNK_SIZE;
+	unsigned long index;
+	PageId *chunk;
+	xa_for_each (&state->chunks, index, chunk) {
+		if (index < firstFree)
+			continue;
+		xa_erase(&state->chunks, index);
+		free_page((unsigned long)chunk);
+	}
+	state->cached_chunk = NULL;
+	//reset the page ids behind the new end in the last chunk
+	if (length % MAPPING_CHUNK_SIZE != 0) {
+		chunk = lookup_chunk(state, length / MAPPING_CHUNK_SIZE);
+		if (chunk != NULL) {
+			memset(&chunk[length % MAPPING_CHUNK_SIZE], 0xff,
+			       (MAPPING_CHUNK_SIZE -
+				length % MAPPING_CHUNK_SIZE) *
+				       sizeof(PageId));
+		}
 	}
-	//replace mapping with resized array
-	vfree(state->mapping);
-	state->mapping = newPageIds;
 	//set new length of mapping
 	state->vpages_count = length;
 	return true;
@@ -50,23 +117,97 @@ PageId get_page_id(struct local_state *state, unsigned long offset)
 	if (offset >= state->vpages_count) {
 		return PAGEID_OFFSET_INVALID; //out of bounds -> return special page id
 	}
-	return state->mapping[offset];
+	PageId *chunk = lookup_chunk(state, offset / MAPPING_CHUNK_SIZE);
+	if (chunk == NULL) {
+		//chunk was never written -> unassigned
+		return PAGEID_UNASSIGNED;
+	}
+	return chunk[offset % MAPPING_CHUNK_SIZE];
 }
 
-void set_page_id(struct local_state *state, unsigned long offset, PageId pageId)
+int set_page_id(struct local_state *state, unsigned long offset, PageId pageId)
 {
 	//first: get old page id
 	PageId previous = get_page_id(state, offset);
 	if (previous == PAGEID_OFFSET_INVALID)
-		return; //offset is invalid-> can not set page id
+		return false; //offset is invalid-> can not set page id
+	if (previous == pageId)
+		return true;
+	PageId *chunk = lookup_chunk(state, offset / MAPPING_CHUNK_SIZE);
+	if (chunk == NULL) {
+		//first assignment inside this chunk -> allocate it
+		chunk = (PageId *)__get_free_page(GFP_KERNEL);
+		if (chunk == NULL) {
+			return false;
+		}
+		memset(chunk, 0xff, PAGE_SIZE);
+		if (xa_err(xa_store(&state->chunks, offset / MAPPING_CHUNK_SIZE,
+				    chunk, GFP_KERNEL))) {
+			free_page((unsigned long)chunk);
+			return false;
+		}
+	}
 	if (previous != PAGEID_UNASSIGNED) {
 		//we replace the previous page -> decrement usage count of previous
 		dec_usage(state->global, previous);
 	}
 	//actually set page id
-	state->mapping[offset] = pageId;
+	chunk[offset % MAPPING_CHUNK_SIZE] = pageId;
 	if (pageId != PAGEID_UNASSIGNED) {
 		//if "real" page: increment usage count
 		inc_usage(state->global, pageId);
 	}
-}
\ No newline at end of file
+	return true;
+}
+
+void copy_page_ids(struct local_state *state, unsigned long start,
+		   unsigned long len, PageId *dest)
+{
+	//copy chunk by chunk, missing chunks are copied as unassigned page ids
+	unsigned long copied = 0;
+	while (copied < len) {
+		unsigned long offset = start + copied;
+		unsigned long inChunk = offset % MAPPING_CHUNK_SIZE;
+		unsigned long n = min_t(unsigned long, len - copied,
+					 MAPPING_CHUNK_SIZE - inChunk);
+		PageId *chunk =
+			lookup_chunk(state, offset / MAPPING_CHUNK_SIZE);
+		const PageId *src =
+			chunk != NULL ? &chunk[inChunk] : unassigned_chunk;
+		memcpy(&dest[copied], src, n * sizeof(PageId));
+		copied += n;
+	}
+}
+
+int lock_mapping_mm(struct local_state *state, struct mm_struct *locked)
+{
+	struct vm_area_struct *vma = state->vma;
+	struct mm_struct *mm = vma->vm_mm;
+	if (mm == locked)
+		return true;
+	//a user reference keeps the page tables alive: before 6.0, exit_mmap frees them without the mmap lock
+	//an exiting address space has no users left, its mappings are closed soon anyway
+	if (!mmget_not_zero(mm))
+		return false;
+	if (!mmap_read_trylock(mm)) {
+		//the last user reference may close the mapping, which takes the global lock
+		mmput_async(mm);
+		return false;
+	}
+	//a vma that is being unmapped is no longer found, its page tables may be freed meanwhile
+	if (find_vma(mm, vma->vm_start) != vma) {
+		mmap_read_unlock(mm);
+		mmput_async(mm);
+		return false;
+	}
+	return true;
+}
+
+void unlock_mapping_mm(struct local_state *state, struct mm_struct *locked)
+{
+	struct mm_struct *mm = state->vma->vm_mm;
+	if (mm == locked)
+		return;
+	mmap_read_unlock(mm);
+	mmput_async(mm);
+}
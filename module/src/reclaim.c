@@ -0,0 +1,407 @@
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/slab.h>
+#include <linux/shrinker.h>
+#include <linux/version.h>
+
+#include "communication.h"
+#include "global_state.h"
+#include "local_state.h"
+#include "reclaim.h"
+
+//minimal number of pages evicted at once when the resident limit is exceeded
+#define RECLAIM_MIN_BATCH 256
+
+//depending on the linux kernel version, page table walks allocate missing page tables
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+#define walk_page_range_ptes apply_to_existing_page_range
+#else
+#define walk_page_range_ptes apply_to_page_range
+#endif
+
+static int harvest_young_(pte_t *pte, unsigned long addr, void *data)
+{
+	//callback: moves the accessed bit of a page table entry to the page info
+	struct local_state *local = data;
+	struct vm_area_struct *vma = local->vma;
+	if (pte_none(*pte) || !ptep_test_and_clear_young(vma, addr, pte))
+		return 0;
+	PageId pageId = get_page_id(local, (addr - vma->vm_start) / 4096);
+	if (pageId < local->global->ppages_count)
+		local->global->pageInfos[pageId].referenced = true;
+	return 0;
+}
+//make backwards compatible (see populate in rewiring-lkm.c)
+#if LINUX_VERSION_CODE <= KERNEL_VERSION(5, 1, 0)
+static int harvest_young(pte_t *pte, pgtable_t token, unsigned long addr,
+			 void *data)
+{
+	return harvest_young_(pte, addr, data);
+}
+#else
+static int harvest_young(pte_t *pte, unsigned long addr, void *data)
+{
+	return harvest_young_(pte, addr, data);
+}
+#endif
+
+static void harvest_mapping(struct local_state *local)
+{
+	//only chunks with assigned pages can have page table entries
+	struct vm_area_struct *vma = local->vma;
+	unsigned long index;
+	PageId *chunk;
+	xa_for_each (&local->chunks, index, chunk) {
+		unsigned long start =
+			vma->vm_start + index * MAPPING_CHUNK_SIZE * 4096;
+		unsigned long end = min(start + MAPPING_CHUNK_SIZE * 4096,
+					vma->vm_end);
+		if (start >= end)
+			continue;
+		walk_page_range_ptes(vma->vm_mm, start, end - start,
+				     harvest_young, local);
+	}
+}
+
+static void zap_run(struct local_state *local, unsigned long start,
+		    unsigned long len)
+{
+	struct vm_area_struct *vma = local->vma;
+	if (len == 0)
+		return;
+	zap_vma_ptes(vma, vma->vm_start + start * 4096 - vma->vm_pgoff * 4096,
+		     len * 4096);
+}
+
+static inline int is_victim(struct global_state *state, PageId pageId)
+{
+	//victims are marked as swapped, their content is still in memory
+	return pageId < state->ppages_count &&
+	       state->pageInfos[pageId].valid &&
+	       state->pageInfos[pageId].swapped;
+}
+
+static void unmap_victims(struct local_state *local)
+{
+	//removes the page table entries of all pages marked for eviction
+	//the address space of the mapping has to be locked (lock_mapping_mm)
+	struct global_state *state = local->global;
+	unsigned long runStart = 0;
+	unsigned long runLen = 0;
+	unsigned long index;
+	PageId *chunk;
+	xa_for_each (&local->chunks, index, chunk) {
+		for (unsigned long i = 0; i < MAPPING_CHUNK_SIZE; i++) {
+			unsigned long offset = index * MAPPING_CHUNK_SIZE + i;
+			if (!is_victim(state, chunk[i]))
+				continue;
+			if (runLen > 0 && runStart + runLen == offset) {
+				runLen++;
+			} else {
+				zap_run(local, runStart, runLen);
+				runStart = offset;
+				runLen = 1;
+			}
+		}
+	}
+	zap_run(local, runStart, runLen);
+}
+
+static void keep_victims(struct local_state *local)
+{
+	//the page table entries of the mapping can not be removed -> its pages stay resident
+	struct global_state *state = local->global;
+	unsigned long index;
+	PageId *chunk;
+	xa_for_each (&local->chunks, index, chunk) {
+		for (unsigned long i = 0; i < MAPPING_CHUNK_SIZE; i++) {
+			if (is_victim(state, chunk[i]))
+				state->pageInfos[chunk[i]].swapped = false;
+		}
+	}
+}
+
+//page chosen for eviction, it is written to the backing file without holding the global lock
+struct victim {
+	PageId pageId;
+	//pinned, so that the memory stays valid while it is written
+	struct page *page;
+	int written;
+};
+
+static unsigned long select_victims(struct global_state *state,
+				    struct victim *victims, unsigned long count,
+				    PageId exclude)
+{
+	//clock: referenced pages lose their reference bit and are skipped once
+	unsigned long selected = 0;
+	unsigned long n = state->ppages_count;
+	for (unsigned long step = 0; step < 2 * n && selected < count; step++) {
+		PageId pageId = state->clock_hand;
+		struct page_info *info = &state->pageInfos[pageId];
+		state->clock_hand = pageId + 1 < n ? pageId + 1 : 0;
+		if (!info->valid || info->cow || info->swapped ||
+		    pageId == exclude)
+			continue;
+		if (info->referenced) {
+			info->referenced = false;
+			continue;
+		}
+		//mark as victim, the content is still valid
+		info->swapped = true;
+		victims[selected++].pageId = pageId;
+	}
+	return selected;
+}
+
+static unsigned long mark_victims(struct global_state *state,
+				  struct victim *victims, unsigned long count,
+				  PageId exclude)
+{
+	//lock the address spaces of all mappings and collect their accessed bits
+	struct local_state *local;
+	list_for_each_entry (local, &state->mappings, list) {
+		local->pt_locked = lock_mapping_mm(local, NULL);
+		if (local->pt_locked)
+			harvest_mapping(local);
+	}
+	unsigned long selected =
+		select_victims(state, victims, count, exclude);
+	//victims used by a busy address space stay resident, the others lose their entries
+	list_for_each_entry (local, &state->mappings, list) {
+		if (!local->pt_locked)
+			keep_victims(local);
+	}
+	list_for_each_entry (local, &state->mappings, list) {
+		if (!local->pt_locked)
+			continue;
+		if (selected > 0)
+			unmap_victims(local);
+		unlock_mapping_mm(local, NULL);
+		local->pt_locked = false;
+	}
+	//keep the remaining victims and pin their memory
+	unsigned long marked = 0;
+	for (unsigned long i = 0; i < selected; i++) {
+		PageId pageId = victims[i].pageId;
+		if (!is_victim(state, pageId))
+			continue;
+		victims[marked].pageId = pageId;
+		victims[marked].page =
+			virt_to_page(state->pageInfos[pageId].kaddr);
+		victims[marked].written = false;
+		get_page(victims[marked].page);
+		marked++;
+	}
+	return marked;
+}
+
+static long evict(struct global_state *state, unsigned long count,
+		  PageId exclude, int nonblock)
+{
+	if (nonblock) {
+		if (!mutex_trylock(&state->lock))
+			return -EBUSY;
+	} else {
+		mutex_lock(&state->lock);
+	}
+	long res = 0;
+	if (state->backing == NULL)
+		res = -EINVAL;
+	else if (state->evicting)
+		res = -EBUSY; //another eviction is writing its victims
+	count = min(count, state->resident_count);
+	if (res < 0 || count == 0 || state->ppages_count == 0) {
+		mutex_unlock(&state->lock);
+		return res;
+	}
+	struct victim *victims =
+		kvmalloc_array(count, sizeof(struct victim), GFP_KERNEL);
+	if (victims == NULL) {
+		mutex_unlock(&state->lock);
+		return -ENOMEM;
+	}
+	state->evicting = true;
+	unsigned long marked = mark_victims(state, victims, count, exclude);
+	//the backing file may be replaced by CONFIGURE_RECLAIM meanwhile
+	struct file *backing = get_file(state->backing);
+	mutex_unlock(&state->lock);
+	//write the victims without the lock: faults and commands continue meanwhile
+	for (unsigned long i = 0; i < marked; i++) {
+		loff_t pos = (loff_t)victims[i].pageId * PAGE_SIZE;
+		victims[i].written =
+			kernel_write(backing, page_address(victims[i].page),
+				     PAGE_SIZE, &pos) == PAGE_SIZE;
+		cond_resched();
+	}
+	fput(backing);
+	//return the memory of victims, that were neither accessed nor mapped meanwhile
+	mutex_lock(&state->lock);
+	long evicted = 0;
+	unsigned long failed = 0;
+	for (unsigned long i = 0; i < marked; i++) {
+		struct page_info *info = &state->pageInfos[victims[i].pageId];
+		if (is_victim(state, victims[i].pageId)) {
+			if (victims[i].written) {
+				free_page_info(state, info);
+				evicted++;
+			} else {
+				//keep the page in memory, it is faulted in again
+				info->swapped = false;
+				failed++;
+			}
+		}
+		put_page(victims[i].page);
+	}
+	state->evicting = false;
+	mutex_unlock(&state->lock);
+	kvfree(victims);
+	if (evicted == 0 && failed > 0)
+		return -EIO;
+	return evicted;
+}
+
+long evict_pages(struct global_state *state, unsigned long count,
+		 PageId exclude)
+{
+	long res = evict(state, count, exclude, false);
+	return res == -EBUSY ? 0 : res;
+}
+
+int over_resident_limit(struct global_state *state)
+{
+	//racy read, evict checks again under the lock
+	unsigned long limit = READ_ONCE(state->resident_limit);
+	return READ_ONCE(state->backing) != NULL && limit != 0 &&
+	       READ_ONCE(state->resident_count) >= limit;
+}
+
+void reclaim_if_needed(struct global_state *state, PageId exclude)
+{
+	if (!over_resident_limit(state))
+		return;
+	//evict a batch, so that not every allocation has to walk the page tables
+	unsigned long limit = READ_ONCE(state->resident_limit);
+	unsigned long resident = READ_ONCE(state->resident_count);
+	unsigned long batch = max(limit / 16, (unsigned long)RECLAIM_MIN_BATCH);
+	evict_pages(state, resident > limit ? resident - limit + batch : batch,
+		    exclude);
+}
+
+int reclaim_for_allocation(struct global_state *state)
+{
+	long res = evict(state, RECLAIM_MIN_BATCH, PAGEID_UNASSIGNED, false);
+	//a running eviction frees memory as well
+	return res > 0 || res == -EBUSY;
+}
+
+int backing_in_use(struct global_state *state)
+{
+	if (state->backing == NULL)
+		return false;
+	if (state->evicting)
+		return true;
+	for (PageId pageId = 0; pageId < state->ppages_count; pageId++) {
+		if (state->pageInfos[pageId].swapped)
+			return true;
+	}
+	return false;
+}
+
+//depending on the linux kernel version, shrinkers are allocated by the kernel or embedded
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+static struct global_state *shrinker_state(struct shrinker *shrinker)
+{
+	return shrinker->private_data;
+}
+#else
+struct state_shrinker {
+	struct shrinker shrinker;
+	struct global_state *state;
+};
+
+static struct global_state *shrinker_state(struct shrinker *shrinker)
+{
+	return container_of(shrinker, struct state_shrinker, shrinker)->state;
+}
+#endif
+
+static unsigned long count_evictable(struct shrinker *shrinker,
+				     struct shrink_control *sc)
+{
+	//racy read, the count is only a hint for the kernel
+	return READ_ONCE(shrinker_state(shrinker)->resident_count);
+}
+
+static unsigned long scan_evictable(struct shrinker *shrinker,
+				    struct shrink_control *sc)
+{
+	//eviction writes to the backing file and must not wait for the global lock:
+	//the allocation that triggered the scan may have been made while holding it
+	if (!(sc->gfp_mask & __GFP_FS))
+		return SHRINK_STOP;
+	long evicted = evict(shrinker_state(shrinker), sc->nr_to_scan,
+			     PAGEID_UNASSIGNED, true);
+	return evicted > 0 ? evicted : SHRINK_STOP;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+int register_reclaim_shrinker(struct global_state *state)
+{
+	if (state->shrinker != NULL)
+		return 0;
+	struct shrinker *shrinker = shrinker_alloc(0, "rewiring");
+	if (shrinker == NULL)
+		return -ENOMEM;
+	shrinker->count_objects = count_evictable;
+	shrinker->scan_objects = scan_evictable;
+	shrinker->private_data = state;
+	shrinker_register(shrinker);
+	state->shrinker = shrinker;
+	return 0;
+}
+
+void unregister_reclaim_shrinker(struct global_state *state)
+{
+	if (state->shrinker == NULL)
+		return;
+	shrinker_free(state->shrinker);
+	state->shrinker = NULL;
+}
+#else
+int register_reclaim_shrinker(struct global_state *state)
+{
+	if (state->shrinker != NULL)
+		return 0;
+	struct state_shrinker *s = kzalloc(sizeof(struct state_shrinker),
+					   GFP_KERNEL);
+	if (s == NULL)
+		return -ENOMEM;
+	s->state = state;
+	s->shrinker.count_objects = count_evictable;
+	s->shrinker.scan_objects = scan_evictable;
+	s->shrinker.seeks = DEFAULT_SEEKS;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 0, 0)
+	int res = register_shrinker(&s->shrinker, "rewiring");
+#else
+	int res = register_shrinker(&s->shrinker);
+#endif
+	if (res < 0) {
+		kfree(s);
+		return res;
+	}
+	state->shrinker = &s->shrinker;
+	return 0;
+}
+
+void unregister_reclaim_shrinker(struct global_state *state)
+{
+	if (state->shrinker == NULL)
+		return;
+	unregister_shrinker(state->shrinker);
+	kfree(container_of(state->shrinker, struct state_shrinker, shrinker));
+	state->shrinker = NULL;
+}
+#endif
@@ -10,10 +10,15 @@
 #include <linux/vmalloc.h>
 #include <linux/version.h>
 #include <linux/mutex.h>
+#include <linux/overflow.h>
+#include <linux/err.h>
 
 #include "communication.h"
 #include "global_state.h"
 #include "local_state.h"
+#include "dedup.h"
+#include "reclaim.h"
+#include "ingest.h"
 
 #define DEVICE_NAME "rewiring"
 #define CLASS_NAME  "rewiring"
@@ -36,7 +41,9 @@ static long dev_unlocked_ioctl(struct file *file, unsigned int cmd,
 			       unsigned long arg);
 
 static int dev_mmap(struct file *filep, struct vm_area_struct *vma);
+static void dev_mmap_open(struct vm_area_struct *vma);
 static void dev_mmap_close(struct vm_area_struct *vma);
+static int dev_mmap_split(struct vm_area_struct *vma, unsigned long addr);
 
 static vm_fault_t fault(struct vm_fault *vmf);
 
@@ -52,8 +59,16 @@ static struct file_operations fops = {
 //vm operations provided by the module
 static struct vm_operations_struct simple_vm_ops = {
     .fault = fault,
-	.page_mkwrite =dev_page_mkwrite,
-	.close = dev_mmap_close
+	//VM_PFNMAP mappings get pfn_mkwrite instead of page_mkwrite calls
+	.pfn_mkwrite = dev_page_mkwrite,
+	.open = dev_mmap_open,
+	.close = dev_mmap_close,
+	//depending on the linux kernel version, the split callback is named differently
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0)
+	.may_split = dev_mmap_split,
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
+	.split = dev_mmap_split,
+#endif
 };
 
 //helper struct
@@ -131,8 +146,61 @@ static int dev_release(struct inode *inodep, struct file *filep)
 
 vm_fault_t dev_page_mkwrite(struct vm_fault *vmf)
 {
-	//features like "copy-on-write" could be implemented here
-	return VM_FAULT_LOCKED;
+	//called on the first write to a read-only page table entry
+	struct vm_area_struct *vma = vmf->vma;
+	struct local_state *state = vma->vm_private_data;
+	if (state == NULL)
+		return VM_FAULT_SIGBUS;
+	mutex_lock(&state->global->lock);
+	unsigned long pos = vmf->pgoff - vma->vm_pgoff;
+	PageId pageId = get_page_id(state, pos);
+	unsigned long sharedKaddr = 0;
+	if (pageId != PAGEID_UNASSIGNED) {
+		if (!is_cow_page(state->global, pageId)) {
+			//page is backed by a private page -> just make the entry writable
+			mutex_unlock(&state->global->lock);
+			return 0;
+		}
+		if (state->global->pageInfos[pageId].usage_count <= 1) {
+			//last user of a deduplicated page -> it is private again
+			state->global->pageInfos[pageId].cow = false;
+			mutex_unlock(&state->global->lock);
+			return 0;
+		}
+		//write to a deduplicated page -> split it by copying
+		kaddr_by_pageId(state->global, pageId, &sharedKaddr);
+	}
+	//write to the shared zero page or a deduplicated page -> now a private page is needed
+	//deduplicated pages are never evicted, so sharedKaddr stays valid
+	pageId = alloc_new_page(state->global);
+	unsigned long kaddr = 0;
+	if (pageId == PAGEID_UNASSIGNED ||
+	    !kaddr_by_pageId(state->global, pageId, &kaddr)) {
+		mutex_unlock(&state->global->lock);
+		//evict pages of this file and let the write fault again
+		if (reclaim_for_allocation(state->global))
+			return VM_FAULT_NOPAGE;
+		printk(KERN_WARNING "REWIRING_LKM: could not allocate new page\n");
+		return VM_FAULT_SIGSEGV;
+	}
+	if (sharedKaddr != 0) {
+		memcpy((void *)kaddr, (void *)sharedKaddr, PAGE_SIZE);
+	}
+	if (!set_page_id(state, pos, pageId)) {
+		mutex_unlock(&state->global->lock);
+		return VM_FAULT_OOM;
+	}
+	//replace the read-only entry by the new page
+	unsigned long addr = vmf->address & PAGE_MASK;
+	zap_vma_ptes(vma, addr, 4096);
+	pgprot_t prot = vm_get_page_prot(vma->vm_flags);
+	vm_fault_t res = vmf_insert_pfn_prot(
+		vma, addr, page_to_pfn(virt_to_page(kaddr)), prot);
+	mutex_unlock(&state->global->lock);
+	//keep the resident limit, the new page stays resident
+	reclaim_if_needed(state->global, pageId);
+	//the entry is already installed, no need to make the old one writable
+	return res;
 }
 
 static vm_fault_t fault(struct vm_fault *vmf)
@@ -141,6 +209,8 @@ static vm_fault_t fault(struct vm_fault *vmf)
 	//get local state from vm_fault
 	struct vm_area_struct *vma = vmf->vma;
 	struct local_state *state = vma->vm_private_data;
+	if (state == NULL)
+		return VM_FAULT_SIGBUS;
 	//lock global state
 	mutex_lock(&state->global->lock);
 	unsigned long pos = vmf->pgoff - vma->vm_pgoff;
@@ -151,15 +221,41 @@ static vm_fault_t fault(struct vm_fault *vmf)
 		printk(KERN_WARNING "REWIRING_LKM: invalid offset %lu\n", pos);
 		return VM_FAULT_SIGSEGV;
 	}
+	if (pageId == PAGEID_UNASSIGNED && !(vmf->flags & FAULT_FLAG_WRITE)) {
+		//read fault on previously unassigned page -> map shared zero page read-only
+		//the page is allocated on the first write (dev_page_mkwrite)
+		pgprot_t prot = vm_get_page_prot(vma->vm_flags & ~VM_WRITE);
+		vm_fault_t res = vmf_insert_pfn_prot(
+			vma, vmf->address,
+			page_to_pfn(ZERO_PAGE(vmf->address)), prot);
+		mutex_unlock(&state->global->lock);
+		return res;
+	}
 	if (pageId == PAGEID_UNASSIGNED) {
-		//fault on previously unassigned page -> alloc new page
+		//write fault on previously unassigned page -> alloc new page
 		pageId = alloc_new_page(state->global);
-        if (pageId == PAGEID_UNASSIGNED) {
-            printk(KERN_WARNING "REWIRING_LKM: could not allocate new page\n");
-            return VM_FAULT_SIGSEGV;
-        }
-            set_page_id(state, pos, pageId);
+		if (pageId == PAGEID_UNASSIGNED) {
+			mutex_unlock(&state->global->lock);
+			//evict pages of this file and let the access fault again
+			if (reclaim_for_allocation(state->global))
+				return VM_FAULT_NOPAGE;
+			printk(KERN_WARNING "REWIRING_LKM: could not allocate new page\n");
+			return VM_FAULT_SIGSEGV;
+		}
+		if (!set_page_id(state, pos, pageId)) {
+			mutex_unlock(&state->global->lock);
+			return VM_FAULT_OOM;
+		}
+	}
+	//evicted page -> read it back from the backing file
+	int swapped = swap_in_page(state->global, pageId);
+	if (swapped < 0) {
+		mutex_unlock(&state->global->lock);
+		if (swapped == -ENOMEM && reclaim_for_allocation(state->global))
+			return VM_FAULT_NOPAGE;
+		return swapped == -ENOMEM ? VM_FAULT_OOM : VM_FAULT_SIGBUS;
 	}
+	state->global->pageInfos[pageId].referenced = true;
 	//retrieve kaddr for page id
 	unsigned long kaddr = 0;
 	bool validKaddr = kaddr_by_pageId(state->global, pageId, &kaddr);
@@ -168,12 +264,17 @@ static vm_fault_t fault(struct vm_fault *vmf)
 		return VM_FAULT_SIGSEGV;
 	}
 	//create page protection flags matching the "mmap protection flags"
-	pgprot_t prot = vm_get_page_prot(vmf->vma->vm_flags);
+	//deduplicated pages are mapped read-only, a write splits them (dev_page_mkwrite)
+	pgprot_t prot = vm_get_page_prot(
+		is_cow_page(state->global, pageId) ? vma->vm_flags & ~VM_WRITE :
+						     vma->vm_flags);
 	//create page table entry and insert it into page table -> fault handled
 	vm_fault_t res = vmf_insert_pfn_prot(
 		vmf->vma, vmf->address, page_to_pfn(virt_to_page(kaddr)), prot);
 	//unlock before returning
 	mutex_unlock(&state->global->lock);
+	//keep the resident limit, the page just faulted in stays resident
+	reclaim_if_needed(state->global, pageId);
 	return res;
 }
 
@@ -181,37 +282,96 @@ static int dev_mmap(struct file *filep, struct vm_area_struct *vma)
 {
 	//set handlers for page faults etc
 	vma->vm_ops = &simple_vm_ops;
-	//enable delete_page_range
-	vma->vm_flags |= VM_PFNMAP;
+	//enable delete_page_range, the mapping can not grow by mremap
+	vma->vm_flags |= VM_PFNMAP | VM_DONTEXPAND;
 	//create local state object and store a pointer to it in the vm_area_struct
 	vma->vm_private_data = kmalloc(sizeof(struct local_state), GFP_KERNEL);
 	//retrieve local state object
 	struct local_state *state = vma->vm_private_data;
     if(state==NULL){
         printk(KERN_WARNING "REWIRING_LKM: could not create internal structures, out of memory!\n");
-        return 1;
+        return -ENOMEM;
     }
 	//init local state
 	init_local_state(state);
 	//link global state
 	state->global = filep->private_data;
-
-    if(!resize_mapping(state, vma_pages(vma))){
-        printk(KERN_WARNING "REWIRING_LKM: could not create mapping storage!\n");
-        return 1;
-    }
+	state->vma = vma;
+	resize_mapping(state, vma_pages(vma));
+	mutex_lock(&state->global->lock);
+	list_add(&state->list, &state->global->mappings);
+	mutex_unlock(&state->global->lock);
 	return 0;
 }
 
+static void dev_mmap_open(struct vm_area_struct *vma)
+{
+	//the vma was copied (fork, moving mremap), the copy still points to the local state of the original
+	//-> give it its own local state with the same page ids
+	struct local_state *original = vma->vm_private_data;
+	struct local_state *state;
+	//copy of an unusable mapping (its state could not be created), the copy stays unusable
+	if (original == NULL)
+		return;
+	state = kmalloc(sizeof(struct local_state), GFP_KERNEL);
+	vma->vm_private_data = state;
+	if (state == NULL) {
+		//the copy is unusable, every access raises SIGBUS
+		printk(KERN_WARNING "REWIRING_LKM: could not create internal structures, out of memory!\n");
+		return;
+	}
+	init_local_state(state);
+	state->global = original->global;
+	state->vma = vma;
+	mutex_lock(&state->global->lock);
+	if (!copy_local_state(state, original)) {
+		printk(KERN_WARNING "REWIRING_LKM: could not copy mapping, out of memory!\n");
+		release_local_state(state);
+		mutex_unlock(&state->global->lock);
+		kfree(state);
+		vma->vm_private_data = NULL;
+		return;
+	}
+	list_add(&state->list, &state->global->mappings);
+	mutex_unlock(&state->global->lock);
+}
+
 static void dev_mmap_close(struct vm_area_struct *vma)
 {
-	release_local_state(vma->vm_private_data);
+	struct local_state *state = vma->vm_private_data;
+	if (state == NULL)
+		return;
+	//unregister mapping from the global state, its pages are no longer used by it
+	mutex_lock(&state->global->lock);
+	list_del(&state->list);
+	release_local_state(state);
+	mutex_unlock(&state->global->lock);
+	kfree(state);
+}
+
+static int dev_mmap_split(struct vm_area_struct *vma, unsigned long addr)
+{
+	//page ids are stored per mapping -> mappings are only unmapped/changed as a whole
+	return -EINVAL;
 }
 
+/**
+ * collects the changed page ids of a SET command and writes the page table
+ * entries of changed pages only
+ */
+struct page_range_update {
+	struct mem_info *info;
+	//run of changed pages whose page table entries are not written yet
+	unsigned long run_start;
+	unsigned long run_len;
+};
+
 inline int populate_(pte_t *pte, unsigned long addr, void *data)
 {
-	//callback function for populating the pagetable
-	struct mem_info *info = data;
+	//callback function for writing the page table entries of a changed run
+	//the old entries were removed by zap_vma_ptes before (see write_changed_run)
+	struct page_range_update *update = data;
+	struct mem_info *info = update->info;
 	unsigned long pos = (addr - info->vma->vm_start) / 4096;
 	PageId pageId = get_page_id(info->state, pos);
 
@@ -221,23 +381,21 @@ inline int populate_(pte_t *pte, unsigned long addr, void *data)
 		       pos);
 		return 0;
 	}
-	if (pageId == PAGEID_UNASSIGNED) {
-		//no page requested
-		return 0;
-	}
 	unsigned long kaddr = 0;
-	bool validKaddr = kaddr_by_pageId(info->state->global, pageId, &kaddr);
-	if (!validKaddr) {
-        //no valid kaddr-> do nothing
+	bool validKaddr = pageId != PAGEID_UNASSIGNED &&
+			  kaddr_by_pageId(info->state->global, pageId, &kaddr);
+	if (!validKaddr || !pte_none(*pte)) {
+		//no page requested or no valid kaddr -> leave entry empty
 		return 0;
 	}
-    //calculate page protection flags
-	pgprot_t prot = vm_get_page_prot(info->vma->vm_flags);
-    //create page table entry
-	pte_t pte_val =
-		pte_mkdevmap(pfn_pte(page_to_pfn(virt_to_page(kaddr)), prot));
-    //set page table entry
-	*pte = pte_val;
+	unsigned long pfn = page_to_pfn(virt_to_page(kaddr));
+	//calculate page protection flags, deduplicated pages are mapped read-only
+	pgprot_t prot = vm_get_page_prot(
+		is_cow_page(info->state->global, pageId) ?
+			info->vma->vm_flags & ~VM_WRITE :
+			info->vma->vm_flags);
+	//create page table entry and set it
+	set_pte_at(info->mm, addr, pte, pte_mkdevmap(pfn_pte(pfn, prot)));
 	return 0;
 }
 //depending on the linux kernel version, the callback signature varies
@@ -245,7 +403,7 @@ inline int populate_(pte_t *pte, unsigned long addr, void *data)
 #if LINUX_VERSION_CODE <= KERNEL_VERSION(5, 1, 0)
 int populate(pte_t *pte, pgtable_t token, unsigned long addr, void *data)
 {
-	populate_(pte, addr, data);
+	return populate_(pte, addr, data);
 }
 #else
 int populate(pte_t *pte, unsigned long addr, void *data)
@@ -254,109 +412,440 @@ int populate(pte_t *pte, unsigned long addr, void *data)
 }
 #endif
 
-static void unmap_page_range(const struct mem_info *info, unsigned long pages,
-			     unsigned long startAddr)
+static void init_page_range_update(struct page_range_update *update,
+				   struct mem_info *info)
 {
-	//deletes all page table entries in a vm_area_struct in a specified range
-	zap_vma_ptes(info->vma, startAddr, pages * 4096);
+	update->info = info;
+	update->run_start = 0;
+	update->run_len = 0;
 }
 
-static void update_page_range(struct mem_info *info, unsigned long start,
-			      unsigned long pages)
+static void write_changed_run(struct page_range_update *update)
 {
-	//updates a certain page range
+	//writes the page table entries of the current run of changed pages
+	struct vm_area_struct *vma = update->info->vma;
+	if (update->run_len == 0)
+		return;
 	unsigned long startAddr =
-		info->vma->vm_start + start * 4096 - info->vma->vm_pgoff * 4096;
-	//first: clear page table areas
-	unmap_page_range(info, pages, startAddr);
-	//then populate again using updated page ids
-	apply_to_page_range(info->mm, startAddr, pages * 4096, populate, info);
+		vma->vm_start + update->run_start * 4096 - vma->vm_pgoff * 4096;
+	//remove the old entries: zap_vma_ptes informs secondary MMUs (mmu notifiers) and
+	//flushes the TLB once per run through an mmu_gather, only if entries were present
+	//faults can not refill the run meanwhile, they wait for the global lock
+	zap_vma_ptes(vma, startAddr, update->run_len * 4096);
+	apply_to_page_range(update->info->mm, startAddr, update->run_len * 4096,
+			    populate, update);
+	update->run_len = 0;
 }
-static long handle_command(struct file *file, struct cmd *command)
+
+/**
+ * sets a page id and schedules the page table update, if the page id changed
+ * @param update the pending update
+ * @param offset the offset inside the mapping area
+ * @param pageId the new page id
+ * @return 0 if successful, -ENOMEM if the mapping could not store the page id
+ */
+static int update_page_id(struct page_range_update *update,
+			  unsigned long offset, PageId pageId)
 {
-	struct mm_struct *mm = current->mm;
-	struct vm_area_struct *vma;
-	if (command->type != CREATE_PAGE_IDS) {
-		//search for the vm_area_struct representing the mapping
-		vma = find_vma(mm, (unsigned long)command->mapping_start);
-		//error handling
-		if (vma == NULL) {
-			return -EINVAL;
-		}
-		if (vma->vm_file != file) {
+	if (get_page_id(update->info->state, offset) == pageId) {
+		//unchanged page: keep its page table entry
+		write_changed_run(update);
+		return 0;
+	}
+	if (!set_page_id(update->info->state, offset, pageId))
+		return -ENOMEM;
+	if (update->run_len > 0 &&
+	    update->run_start + update->run_len != offset) {
+		write_changed_run(update);
+	}
+	if (update->run_len == 0)
+		update->run_start = offset;
+	update->run_len++;
+	return 0;
+}
+
+static void finish_page_range_update(struct page_range_update *update)
+{
+	write_changed_run(update);
+}
+//checks that every page id described by a run refers to an existing page
+static int valid_run(struct local_state *state, struct page_id_run *run)
+{
+	if (run->count == 0 || run->count > state->vpages_count)
+		return false;
+	if (run->first == PAGEID_UNASSIGNED)
+		return run->stride == 0;
+	long long last = (long long)run->first +
+			 (long long)(run->count - 1) * run->stride;
+	if (last < 0 || last >= state->global->ppages_count ||
+	    run->first >= state->global->ppages_count)
+		return false;
+	//pages freed by deduplication keep their (now invalid) page ids
+	PageId pageId = run->first;
+	unsigned long ids = run->stride == 0 ? 1 : run->count;
+	for (unsigned long i = 0; i < ids; i++) {
+		if (!valid_page_id(state->global, pageId))
+			return false;
+		pageId += run->stride;
+	}
+	return true;
+}
+
+/**
+ * validates runs of page ids (SET_PAGE_IDS_ENCODED)
+ * @param state the local state of the mapping
+ * @param runs the runs copied to kernel space
+ * @param command the command
+ * @return 0 if all runs fit into the mapping and describe valid page ids, -EINVAL otherwise
+ */
+static int check_runs(struct local_state *state, struct page_id_run *runs,
+		      struct cmd *command)
+{
+	unsigned long pos = command->start;
+	if (pos > state->vpages_count)
+		return -EINVAL;
+	for (unsigned long r = 0; r < command->len; r++) {
+		if (!valid_run(state, &runs[r]) ||
+		    runs[r].count > state->vpages_count - pos)
 			return -EINVAL;
+		pos += runs[r].count;
+	}
+	return 0;
+}
+
+/**
+ * expands validated runs of page ids directly into the mapping
+ * @param update the pending update
+ * @param runs the runs checked by check_runs
+ * @param command the command
+ * @return 0 if successful, a negative error code otherwise
+ */
+static int expand_runs(struct page_range_update *update,
+		       struct page_id_run *runs, struct cmd *command)
+{
+	unsigned long pos = command->start;
+	for (unsigned long r = 0; r < command->len; r++) {
+		//unsigned arithmetic also handles negative strides
+		PageId pageId = runs[r].first;
+		for (unsigned long j = 0; j < runs[r].count; j++) {
+			int res = update_page_id(update, pos + j, pageId);
+			if (res < 0)
+				return res;
+			pageId += runs[r].stride;
 		}
-	} else {
-		//CREATE_PAGE_IDS does not need a local state/mapping
+		pos += runs[r].count;
 	}
-	struct local_state *state = vma->vm_private_data;
+	return 0;
+}
+/**
+ * looks up the mapping a command refers to and locks it
+ * the mmap lock of the calling process is taken before the global lock, like in page faults
+ * no user memory may be accessed until unlock_command_mapping, as a fault on it takes the same locks
+ * @param file the rewiring file
+ * @param command the command, mapping_start points into the mapping
+ * @param info filled with the state, vma and mm of the mapping
+ * @return 0 if successful, -EINVAL if the mapping does not belong to the file
+ */
+static int lock_command_mapping(struct file *file, struct cmd *command,
+				struct mem_info *info)
+{
+	struct mm_struct *mm = current->mm;
+	unsigned long addr = (unsigned long)command->mapping_start;
+	mmap_read_lock(mm);
+	//search for the vm_area_struct representing the mapping
+	struct vm_area_struct *vma = find_vma(mm, addr);
+	//error handling
+	if (vma == NULL || vma->vm_start > addr || vma->vm_file != file ||
+	    vma->vm_private_data == NULL) {
+		mmap_read_unlock(mm);
+		return -EINVAL;
+	}
+	info->state = vma->vm_private_data;
+	info->vma = vma;
+	info->mm = mm;
+	mutex_lock(&info->state->global->lock);
+	return 0;
+}
 
-	switch (command->type) {
-	case SET_PAGE_IDS: {
-		//retrieve arguments: start,len, ptr to array in userspace
-		//check that parameters are valid
-		if (command->start + command->len > state->vpages_count) {
-			return -EINVAL;
+static void unlock_command_mapping(struct mem_info *info)
+{
+	mutex_unlock(&info->state->global->lock);
+	mmap_read_unlock(info->mm);
+}
+
+/**
+ * copies an array of len elements of the given size from userspace to a new kernel buffer
+ * user memory is only accessed without any lock held (it may be a rewired mapping itself)
+ * @return the buffer (to be freed with vfree) or an ERR_PTR
+ */
+static void *copy_array_from_user(const void __user *src, unsigned long len,
+				  size_t size)
+{
+	size_t bytes = array_size(len, size);
+	void *buffer = vmalloc(max_t(size_t, bytes, 1));
+	if (buffer == NULL) {
+		printk(KERN_WARNING "REWIRING_LKM: could not allocate memory for temporary storage!\n");
+		return ERR_PTR(-ENOMEM);
+	}
+	if (copy_from_user(buffer, src, bytes)) {
+		vfree(buffer);
+		return ERR_PTR(-EFAULT);
+	}
+	return buffer;
+}
+
+static long set_page_ids(struct file *file, struct cmd *command)
+{
+	//retrieve arguments: start,len, ptr to array in userspace
+	//copy the new page ids to a temporary array in kernel space before locking
+	PageId *newPageIds =
+		copy_array_from_user(command->payload, command->len, sizeof(PageId));
+	if (IS_ERR(newPageIds)) {
+		return PTR_ERR(newPageIds);
+	}
+	struct mem_info info;
+	long res = lock_command_mapping(file, command, &info);
+	if (res < 0) {
+		vfree(newPageIds);
+		return res;
+	}
+	struct local_state *state = info.state;
+	//check that parameters are valid
+	if (command->start > state->vpages_count ||
+	    command->len > state->vpages_count - command->start) {
+		res = -EINVAL;
+	}
+	//check if any of the new PageIds is invalid (out-of-range or freed)
+	//PAGEID_UNASSIGNED is allowed and removes the page from the mapping
+	for (unsigned long i = 0; i < command->len && res == 0; i++) {
+		if (newPageIds[i] != PAGEID_UNASSIGNED &&
+		    !valid_page_id(state->global, newPageIds[i])) {
+			res = -EINVAL;
 		}
+	}
+	if (res == 0) {
+		//process data, only changed pages are written to the page table
+		struct page_range_update update;
+		init_page_range_update(&update, &info);
+		for (unsigned long i = 0; i < command->len && res == 0; i++) {
+			res = update_page_id(&update, command->start + i,
+					     newPageIds[i]);
+		}
+		//page ids set so far are written to the page table, also on error
+		finish_page_range_update(&update);
+	}
+	unlock_command_mapping(&info);
+	//free temporary array
+	vfree(newPageIds);
+	return res;
+}
 
-		//create temporary array in kernel space and copy data
-		PageId *newPageIds = vmalloc(command->len * sizeof(PageId));
-		if(newPageIds==NULL){
-            printk(KERN_WARNING "REWIRING_LKM: could not allocate memory for temporary storage!\n");
-            return -ENOMEM;
-        }
-		copy_from_user(newPageIds, command->payload,
-			       command->len * sizeof(PageId));
-		//check if any of the new PageIds is out-of-range
-		for (unsigned long i = 0; i < command->len; i++)
-			if (newPageIds[i] >= state->global->page_info_size)
-				return -EINVAL;
-		//process data
-		for (unsigned long i = 0; i < command->len; i++) {
-			set_page_id(state, command->start + i, newPageIds[i]);
+static long set_page_ids_encoded(struct file *file, struct cmd *command)
+{
+	//copy the runs once, then validate all of them before the mapping is changed
+	struct page_id_run *runs = copy_array_from_user(
+		command->payload, command->len, sizeof(struct page_id_run));
+	if (IS_ERR(runs)) {
+		return PTR_ERR(runs);
+	}
+	struct mem_info info;
+	long res = lock_command_mapping(file, command, &info);
+	if (res < 0) {
+		vfree(runs);
+		return res;
+	}
+	res = check_runs(info.state, runs, command);
+	if (res == 0) {
+		struct page_range_update update;
+		init_page_range_update(&update, &info);
+		res = expand_runs(&update, runs, command);
+		finish_page_range_update(&update);
+	}
+	unlock_command_mapping(&info);
+	vfree(runs);
+	return res;
+}
+
+//number of page ids copied to userspace per lock round trip (GET_PAGE_IDS)
+#define GET_BATCH (16 * MAPPING_CHUNK_SIZE)
+
+static long get_page_ids(struct file *file, struct cmd *command)
+{
+	//the page ids are copied in bounded batches: huge sparse mappings need no huge kernel buffer
+	//every batch is copied to userspace without any lock held
+	PageId *pageIds = kvmalloc_array(GET_BATCH, sizeof(PageId), GFP_KERNEL);
+	if (pageIds == NULL) {
+		return -ENOMEM;
+	}
+	long res = 0;
+	for (unsigned long copied = 0; copied < command->len && res == 0;) {
+		unsigned long n = min_t(unsigned long, command->len - copied,
+					GET_BATCH);
+		struct mem_info info;
+		res = lock_command_mapping(file, command, &info);
+		if (res < 0) {
+			break;
 		}
-		//free temporary array
-		vfree(newPageIds);
-		//put important infos into internal structure
-		struct mem_info info = {
-			.state = vma->vm_private_data,
-			.vma = vma,
-			.mm = mm,
-		};
-		//update relevant page range
-		update_page_range(&info, command->start, command->len);
-	} break;
-	case GET_PAGE_IDS: {
+		struct local_state *state = info.state;
 		//check that parameter are valid
-		if (command->start + command->len > state->vpages_count) {
-			return -EINVAL;
+		if (command->start > state->vpages_count ||
+		    command->len > state->vpages_count - command->start) {
+			res = -EINVAL;
+		} else {
+			copy_page_ids(state, command->start + copied, n, pageIds);
 		}
-		//copy part of state->mapping to the userspace
-		copy_to_user(command->payload, &state->mapping[command->start],
-			     command->len * sizeof(PageId));
-	} break;
-	case CREATE_PAGE_IDS: {
-		for (unsigned int i = 0; i < command->len; i++) {
-			PageId pageId = alloc_new_page(file->private_data);
-			if(pageId==PAGEID_UNASSIGNED){
-                printk(KERN_WARNING "REWIRING_LKM: could not allocate page!\n");
-                return -ENOMEM;
-            }
-			PageId *target_arr = command->payload;
-			copy_to_user(&target_arr[i], &pageId, sizeof(PageId));
+		unlock_command_mapping(&info);
+		//copy part of the mapping to the userspace
+		if (res == 0 && copy_to_user((PageId *)command->payload + copied,
+					     pageIds, n * sizeof(PageId))) {
+			res = -EFAULT;
 		}
-	} break;
-	default:
-		break;
+		copied += n;
+		cond_resched();
+	}
+	kvfree(pageIds);
+	return res;
+}
+
+static long create_page_ids(struct global_state *global, struct cmd *command)
+{
+	PageId *pageIds = vmalloc(
+		max_t(size_t, array_size(command->len, sizeof(PageId)), 1));
+	if (pageIds == NULL) {
+		return -ENOMEM;
+	}
+	long res = 0;
+	unsigned long created = 0;
+	while (created < command->len) {
+		//keep the resident limit, eviction takes the global lock itself
+		reclaim_if_needed(global, PAGEID_UNASSIGNED);
+		mutex_lock(&global->lock);
+		pageIds[created] = alloc_new_page(global);
+		mutex_unlock(&global->lock);
+		if (pageIds[created] != PAGEID_UNASSIGNED) {
+			created++;
+		} else if (!reclaim_for_allocation(global)) {
+			printk(KERN_WARNING "REWIRING_LKM: could not allocate page!\n");
+			res = -ENOMEM;
+			break;
+		}
+	}
+	if (res == 0 && copy_to_user(command->payload, pageIds,
+				     command->len * sizeof(PageId))) {
+		res = -EFAULT;
+	}
+	if (res < 0) {
+		//the page ids do not reach userspace -> free the pages again
+		mutex_lock(&global->lock);
+		for (unsigned long i = 0; i < created; i++) {
+			free_page_info(global, &global->pageInfos[pageIds[i]]);
+		}
+		mutex_unlock(&global->lock);
+	}
+	vfree(pageIds);
+	return res;
+}
+
+static long deduplicate(struct global_state *global, struct cmd *command)
+{
+	//the mappings of the calling process are rewritten under its mmap lock,
+	//mappings of other processes only if their mmap lock is free (see lock_mapping_mm)
+	struct mm_struct *mm = current->mm;
+	mmap_read_lock(mm);
+	mutex_lock(&global->lock);
+	long freed = dedup_pages(global, mm);
+	mutex_unlock(&global->lock);
+	mmap_read_unlock(mm);
+	if (freed < 0) {
+		return freed;
+	}
+	unsigned long result = freed;
+	if (copy_to_user(command->payload, &result, sizeof(result))) {
+		return -EFAULT;
 	}
 	return 0;
 }
+
+static long configure_reclaim(struct global_state *global, struct cmd *command)
+{
+	//start: file descriptor of the backing file, len: resident limit
+	struct file *backing = fget(command->start);
+	if (backing == NULL) {
+		return -EBADF;
+	}
+	if (!(backing->f_mode & FMODE_READ) ||
+	    !(backing->f_mode & FMODE_WRITE)) {
+		fput(backing);
+		return -EBADF;
+	}
+	mutex_lock(&global->lock);
+	if (global->backing != NULL &&
+	    file_inode(global->backing) == file_inode(backing)) {
+		//same backing file -> only the limit changes
+		fput(backing);
+		backing = NULL;
+	} else if (backing_in_use(global)) {
+		//evicted pages have to be read from the current backing file
+		mutex_unlock(&global->lock);
+		fput(backing);
+		return -EBUSY;
+	}
+	//evict pages under global memory pressure as well
+	long res = register_reclaim_shrinker(global);
+	if (res < 0) {
+		mutex_unlock(&global->lock);
+		if (backing != NULL) {
+			fput(backing);
+		}
+		return res;
+	}
+	if (backing != NULL) {
+		if (global->backing != NULL) {
+			fput(global->backing);
+		}
+		global->backing = backing;
+	}
+	global->resident_limit = command->len;
+	//from now on, pages are charged to the memory cgroup of the allocating task
+	//allocations fail early instead of invoking the OOM killer, the pages of the file are evicted instead
+	global->gfp = GFP_KERNEL_ACCOUNT | __GFP_NORETRY | __GFP_NOWARN;
+	mutex_unlock(&global->lock);
+	reclaim_if_needed(global, PAGEID_UNASSIGNED);
+	return 0;
+}
+
+static long evict(struct global_state *global, struct cmd *command)
+{
+	long evicted = evict_pages(global, command->len, PAGEID_UNASSIGNED);
+	if (evicted < 0) {
+		return evicted;
+	}
+	unsigned long result = evicted;
+	if (copy_to_user(command->payload, &result, sizeof(result))) {
+		return -EFAULT;
+	}
+	return 0;
+}
+
+static long ingest(struct global_state *global, struct cmd *command)
+{
+	struct write_pages_args args;
+	if (copy_from_user(&args, command->payload, sizeof(args))) {
+		return -EFAULT;
+	}
+	//write_pages takes the global lock itself, only while no user memory is accessed
+	long res = write_pages(global, &args, command->len);
+	return res < 0 ? res : 0;
+}
+
 /**
  * handles ioctl calls
+ * every command takes the locks it needs itself: user memory is only accessed without locks,
+ * as a fault on a rewired mapping takes the mmap lock and the global lock (in this order)
  * @param file file struct pointer
  * @param cmd ioctl command, has to be REW_CMD
  * @param arg pointer to a struct cmd
- * @return 0, if everything works,1 otherwise
+ * @return 0, if everything works, a negative error code otherwise
  */
 static long dev_unlocked_ioctl(struct file *file, unsigned int cmd,
 			       unsigned long arg)
@@ -367,13 +856,30 @@ static long dev_unlocked_ioctl(struct file *file, unsigned int cmd,
 	}
 	struct cmd command;
 	//retrieve command
-	copy_from_user(&command, (struct cmd *)arg, sizeof(struct cmd));
-	//lock module
+	if (copy_from_user(&command, (struct cmd *)arg, sizeof(struct cmd))) {
+		return -EFAULT;
+	}
 	struct global_state *state = (struct global_state *)file->private_data;
-	mutex_unlock(&state->lock);
-	long res = handle_command(file, &command);
-	mutex_unlock(&state->lock);
-	return res;
+	switch (command.type) {
+	case SET_PAGE_IDS:
+		return set_page_ids(file, &command);
+	case SET_PAGE_IDS_ENCODED:
+		return set_page_ids_encoded(file, &command);
+	case GET_PAGE_IDS:
+		return get_page_ids(file, &command);
+	case CREATE_PAGE_IDS:
+		return create_page_ids(state, &command);
+	case DEDUP_PAGES:
+		return deduplicate(state, &command);
+	case CONFIGURE_RECLAIM:
+		return configure_reclaim(state, &command);
+	case EVICT_PAGES:
+		return evict(state, &command);
+	case WRITE_PAGES:
+		return ingest(state, &command);
+	default:
+		return -EINVAL;
+	}
 }
 
 //register init/exit functions of module